@@ -18,6 +18,7 @@ public class PlasticSourceControl : ModuleRules
 				"XmlParser2",
 				"Projects",
 				"AssetRegistry",
+				"DirectoryWatcher",
 			}
 		);
 	}
@@ -0,0 +1,438 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlCacheSnapshot.h"
+
+#if PLATFORM_MAC || PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** "PSCS" magic number at the beginning of the file, also detecting a file written with another byte order */
+static const uint32 SnapshotMagic = 0x53435350;
+
+/** Version of the format, to increment with each change to the layout below */
+static const uint32 SnapshotVersion = 4;
+
+/** Reference to a UTF-8 string of the string pool */
+struct FPlasticSnapshotPoolString
+{
+	uint32 Offset;
+	uint32 Len;
+};
+
+/** Fixed header at the beginning of the file */
+struct FPlasticSnapshotHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	int32 Changeset;
+	uint32 NbRecords;
+	FPlasticSnapshotPoolString WorkspaceRoot;
+	uint32 PathTableOffset;
+	uint32 RecordsOffset;
+	uint32 StringPoolOffset;
+	uint32 StringPoolSize;
+};
+
+/** Fixed-width state of a file */
+struct FPlasticSnapshotRecord
+{
+	FPlasticSnapshotPoolString LocalFilename;
+	uint32 WorkspaceState;
+	int32 LocalRevisionChangeset;
+	int32 DepotRevisionChangeset;
+	FPlasticSnapshotPoolString LockedBy;
+	FPlasticSnapshotPoolString LockedWhere;
+	FPlasticSnapshotPoolString PendingMergeBaseFileHash;
+	FPlasticSnapshotPoolString MovedFrom;
+};
+
+static_assert(sizeof(FPlasticSnapshotPoolString) == 8, "Unexpected padding in the snapshot layout");
+static_assert(sizeof(FPlasticSnapshotHeader) == 44, "Unexpected padding in the snapshot layout");
+static_assert(sizeof(FPlasticSnapshotRecord) == 52, "Unexpected padding in the snapshot layout");
+
+/** Compare a UTF-8 path of the path table to the searched one, in the order used to sort the table */
+static FORCEINLINE int32 ComparePaths(const uint8* InPathA, const uint32 InLenA, const uint8* InPathB, const uint32 InLenB)
+{
+	const int32 Result = FMemory::Memcmp(InPathA, InPathB, FMath::Min(InLenA, InLenB));
+	return (Result != 0) ? Result : (static_cast<int32>(InLenA) - static_cast<int32>(InLenB));
+}
+
+/**
+ * Helper to build the string pool of a snapshot, storing only once the strings repeated across records (user and workspace names)
+ */
+class FPlasticSnapshotStringPool
+{
+public:
+	FPlasticSnapshotPoolString Add(const FString& InString)
+	{
+		FPlasticSnapshotPoolString PoolString = { 0, 0 };
+		if (InString.IsEmpty())
+		{
+			return PoolString;
+		}
+		FTCHARToUTF8 Converter(*InString);
+		const uint8* StringBytes = reinterpret_cast<const uint8*>(Converter.Get());
+		const int32 StringLen = Converter.Length();
+		// Note: keys of a TMap of FString are case-insensitive, so an existing string is only reused if it has the exact same bytes
+		const FPlasticSnapshotPoolString* Existing = Deduplicated.Find(InString);
+		if ((Existing != nullptr) && (Existing->Len == static_cast<uint32>(StringLen)) && (FMemory::Memcmp(Bytes.GetData() + Existing->Offset, StringBytes, StringLen) == 0))
+		{
+			return *Existing;
+		}
+		PoolString = AddBytes(StringBytes, StringLen);
+		if (Existing == nullptr)
+		{
+			Deduplicated.Add(InString, PoolString);
+		}
+		return PoolString;
+	}
+
+	FPlasticSnapshotPoolString AddBytes(const uint8* InBytes, const int32 InLen)
+	{
+		FPlasticSnapshotPoolString PoolString;
+		PoolString.Offset = Bytes.Num();
+		PoolString.Len = InLen;
+		Bytes.Append(InBytes, InLen);
+		return PoolString;
+	}
+
+	TArray<uint8> Bytes;
+
+private:
+	TMap<FString, FPlasticSnapshotPoolString> Deduplicated;
+};
+
+FPlasticSourceControlCacheSnapshot::FPlasticSourceControlCacheSnapshot()
+	: Data(nullptr)
+	, DataSize(0)
+	, Changeset(-1)
+	, NbRecords(0)
+	, PathTable(nullptr)
+	, Records(nullptr)
+	, StringPool(nullptr)
+	, StringPoolSize(0)
+#if PLATFORM_WINDOWS
+	, FileHandle(nullptr)
+	, MappingHandle(nullptr)
+#endif
+{
+}
+
+FPlasticSourceControlCacheSnapshot::~FPlasticSourceControlCacheSnapshot()
+{
+	Close();
+}
+
+FString FPlasticSourceControlCacheSnapshot::GetFilename()
+{
+	// Full path, for the native memory mapping functions
+	return FPaths::ConvertRelativePathToFull(FPaths::GameSavedDir() / TEXT("SourceControl") / TEXT("PlasticStateCache.bin"));
+}
+
+bool FPlasticSourceControlCacheSnapshot::Save(const FString& InFilename, const FString& InWorkspaceRoot, const int32 InChangeset, const TMap<FString, TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> >& InStateCache, FPlasticSourceControlCacheSnapshot& InOutSnapshot)
+{
+	// Gather the states worth persisting: Unknown states are what the cache would return anyway
+	TArray<FPlasticSourceControlState> States;
+	States.Reserve(InStateCache.Num() + InOutSnapshot.Num());
+	for (const auto& CacheItem : InStateCache)
+	{
+		if (CacheItem.Value->WorkspaceState != EWorkspaceState::Unknown)
+		{
+			States.Add(CacheItem.Value.Get());
+		}
+	}
+	// along with the files of the previous snapshot never looked up during this session, if still on disk,
+	// their revisions being dropped if they were read at another changeset than the one the new snapshot is tagged with
+	const bool bSameChangeset = (InOutSnapshot.GetChangeset() == InChangeset);
+	for (int32 Index = 0; Index < InOutSnapshot.Num(); Index++)
+	{
+		const FString Filename = InOutSnapshot.GetFilename(Index);
+		if (!InStateCache.Contains(Filename))
+		{
+			FPlasticSourceControlState State = InOutSnapshot.GetState(Index);
+			if ((State.WorkspaceState == EWorkspaceState::Deleted) || FPaths::FileExists(Filename))
+			{
+				if (!bSameChangeset)
+				{
+					State.LocalRevisionChangeset = -1;
+					State.DepotRevisionChangeset = -1;
+				}
+				States.Add(State);
+			}
+		}
+	}
+	InOutSnapshot.Close();
+
+	// Build the string pool, starting with the paths, then sort the path table by the UTF-8 bytes of their lower case keys
+	FPlasticSnapshotStringPool StringPool;
+	TArray<FPlasticSnapshotPoolString> Paths;
+	TArray<FPlasticSnapshotPoolString> Filenames;
+	Paths.Reserve(States.Num());
+	Filenames.Reserve(States.Num());
+	for (const FPlasticSourceControlState& State : States)
+	{
+		const FString Key = State.LocalFilename.ToLower();
+		FTCHARToUTF8 KeyConverter(*Key);
+		Paths.Add(StringPool.AddBytes(reinterpret_cast<const uint8*>(KeyConverter.Get()), KeyConverter.Length()));
+		if (Key.Equals(State.LocalFilename, ESearchCase::CaseSensitive))
+		{
+			Filenames.Add(Paths.Last());
+		}
+		else
+		{
+			FTCHARToUTF8 Converter(*State.LocalFilename);
+			Filenames.Add(StringPool.AddBytes(reinterpret_cast<const uint8*>(Converter.Get()), Converter.Length()));
+		}
+	}
+	TArray<int32> SortedIndexes;
+	SortedIndexes.Reserve(States.Num());
+	for (int32 Index = 0; Index < States.Num(); Index++)
+	{
+		SortedIndexes.Add(Index);
+	}
+	const uint8* PoolBytes = StringPool.Bytes.GetData();
+	SortedIndexes.Sort([&Paths, PoolBytes](const int32 A, const int32 B)
+	{
+		return ComparePaths(PoolBytes + Paths[A].Offset, Paths[A].Len, PoolBytes + Paths[B].Offset, Paths[B].Len) < 0;
+	});
+
+	TArray<FPlasticSnapshotPoolString> PathTable;
+	TArray<FPlasticSnapshotRecord> Records;
+	PathTable.Reserve(States.Num());
+	Records.Reserve(States.Num());
+	for (const int32 Index : SortedIndexes)
+	{
+		const FPlasticSourceControlState& State = States[Index];
+		PathTable.Add(Paths[Index]);
+		FPlasticSnapshotRecord Record;
+		Record.LocalFilename = Filenames[Index];
+		Record.WorkspaceState = static_cast<uint32>(State.WorkspaceState);
+		Record.LocalRevisionChangeset = State.LocalRevisionChangeset;
+		Record.DepotRevisionChangeset = State.DepotRevisionChangeset;
+		Record.LockedBy = StringPool.Add(State.LockedBy);
+		Record.LockedWhere = StringPool.Add(State.LockedWhere);
+		Record.PendingMergeBaseFileHash = StringPool.Add(State.PendingMergeBaseFileHash);
+		Record.MovedFrom = StringPool.Add(State.MovedFrom);
+		Records.Add(Record);
+	}
+
+	FPlasticSnapshotHeader Header;
+	Header.Magic = SnapshotMagic;
+	Header.Version = SnapshotVersion;
+	Header.Changeset = InChangeset;
+	Header.NbRecords = Records.Num();
+	Header.WorkspaceRoot = StringPool.Add(InWorkspaceRoot);
+	Header.PathTableOffset = sizeof(FPlasticSnapshotHeader);
+	Header.RecordsOffset = Header.PathTableOffset + PathTable.Num() * sizeof(FPlasticSnapshotPoolString);
+	Header.StringPoolOffset = Header.RecordsOffset + Records.Num() * sizeof(FPlasticSnapshotRecord);
+	Header.StringPoolSize = StringPool.Bytes.Num();
+
+	TArray<uint8> Bytes;
+	Bytes.Reserve(Header.StringPoolOffset + Header.StringPoolSize);
+	Bytes.Append(reinterpret_cast<const uint8*>(&Header), sizeof(FPlasticSnapshotHeader));
+	Bytes.Append(reinterpret_cast<const uint8*>(PathTable.GetData()), PathTable.Num() * sizeof(FPlasticSnapshotPoolString));
+	Bytes.Append(reinterpret_cast<const uint8*>(Records.GetData()), Records.Num() * sizeof(FPlasticSnapshotRecord));
+	Bytes.Append(StringPool.Bytes);
+
+	const bool bSaved = FFileHelper::SaveArrayToFile(Bytes, *InFilename);
+	UE_LOG(LogSourceControl, Log, TEXT("Save state cache snapshot (%d states at cs:%d, %d bytes): %d"), Records.Num(), InChangeset, Bytes.Num(), bSaved);
+	return bSaved;
+}
+
+bool FPlasticSourceControlCacheSnapshot::Open(const FString& InFilename, const FString& InWorkspaceRoot)
+{
+	Close();
+
+#if PLATFORM_WINDOWS
+	FileHandle = ::CreateFileW(*InFilename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (FileHandle == INVALID_HANDLE_VALUE)
+	{
+		FileHandle = nullptr;
+		return false;
+	}
+	LARGE_INTEGER FileSize;
+	if (::GetFileSizeEx(FileHandle, &FileSize) && (FileSize.QuadPart >= static_cast<LONGLONG>(sizeof(FPlasticSnapshotHeader))))
+	{
+		MappingHandle = ::CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (MappingHandle != nullptr)
+		{
+			Data = static_cast<const uint8*>(::MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+			DataSize = FileSize.QuadPart;
+		}
+	}
+#elif PLATFORM_MAC || PLATFORM_LINUX
+	const int Fd = open(TCHAR_TO_UTF8(*InFilename), O_RDONLY);
+	if (Fd < 0)
+	{
+		return false;
+	}
+	struct stat FileStat;
+	if ((fstat(Fd, &FileStat) == 0) && (FileStat.st_size >= static_cast<off_t>(sizeof(FPlasticSnapshotHeader))))
+	{
+		void* Mapping = mmap(nullptr, FileStat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+		if (Mapping != MAP_FAILED)
+		{
+			Data = static_cast<const uint8*>(Mapping);
+			DataSize = FileStat.st_size;
+		}
+	}
+	close(Fd); // the mapping stays valid
+#else
+	// No memory mapping: read the whole file at once, lookups are still done in place
+	if (FFileHelper::LoadFileToArray(Buffer, *InFilename, FILEREAD_Silent) && (Buffer.Num() >= static_cast<int32>(sizeof(FPlasticSnapshotHeader))))
+	{
+		Data = Buffer.GetData();
+		DataSize = Buffer.Num();
+	}
+#endif
+
+	if (Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	// Check the header and the bounds of the sections, once and for all
+	FPlasticSnapshotHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(FPlasticSnapshotHeader));
+	if ((Header.Magic != SnapshotMagic) || (Header.Version != SnapshotVersion))
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("State cache snapshot '%s' in an unknown format"), *InFilename);
+		Close();
+		return false;
+	}
+	const uint64 PathTableEnd = Header.PathTableOffset + static_cast<uint64>(Header.NbRecords) * sizeof(FPlasticSnapshotPoolString);
+	const uint64 RecordsEnd = Header.RecordsOffset + static_cast<uint64>(Header.NbRecords) * sizeof(FPlasticSnapshotRecord);
+	const uint64 StringPoolEnd = static_cast<uint64>(Header.StringPoolOffset) + Header.StringPoolSize;
+	if ((Header.NbRecords > MAX_int32) || (PathTableEnd > static_cast<uint64>(DataSize)) || (RecordsEnd > static_cast<uint64>(DataSize)) || (StringPoolEnd > static_cast<uint64>(DataSize))
+		|| (Header.PathTableOffset % 4 != 0) || (Header.RecordsOffset % 4 != 0))
+	{
+		UE_LOG(LogSourceControl, Warning, TEXT("State cache snapshot '%s' is corrupted"), *InFilename);
+		Close();
+		return false;
+	}
+	PathTable = reinterpret_cast<const FPlasticSnapshotPoolString*>(Data + Header.PathTableOffset);
+	Records = reinterpret_cast<const FPlasticSnapshotRecord*>(Data + Header.RecordsOffset);
+	StringPool = Data + Header.StringPoolOffset;
+	StringPoolSize = Header.StringPoolSize;
+	NbRecords = Header.NbRecords;
+	Changeset = Header.Changeset;
+
+	if (GetPoolString(Header.WorkspaceRoot.Offset, Header.WorkspaceRoot.Len) != InWorkspaceRoot)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("State cache snapshot '%s' not for workspace '%s'"), *InFilename, *InWorkspaceRoot);
+		Close();
+		return false;
+	}
+
+	UE_LOG(LogSourceControl, Log, TEXT("Opened state cache snapshot (%d states at cs:%d)"), NbRecords, Changeset);
+	return true;
+}
+
+void FPlasticSourceControlCacheSnapshot::Close()
+{
+#if PLATFORM_WINDOWS
+	if (Data != nullptr)
+	{
+		::UnmapViewOfFile(Data);
+	}
+	if (MappingHandle != nullptr)
+	{
+		::CloseHandle(MappingHandle);
+		MappingHandle = nullptr;
+	}
+	if (FileHandle != nullptr)
+	{
+		::CloseHandle(FileHandle);
+		FileHandle = nullptr;
+	}
+#elif PLATFORM_MAC || PLATFORM_LINUX
+	if (Data != nullptr)
+	{
+		munmap(const_cast<uint8*>(Data), DataSize);
+	}
+#endif
+	Buffer.Empty();
+	Data = nullptr;
+	DataSize = 0;
+	Changeset = -1;
+	NbRecords = 0;
+	PathTable = nullptr;
+	Records = nullptr;
+	StringPool = nullptr;
+	StringPoolSize = 0;
+}
+
+FString FPlasticSourceControlCacheSnapshot::GetPoolString(const uint32 InOffset, const uint32 InLen) const
+{
+	FString String;
+	if ((InLen > 0) && (static_cast<uint64>(InOffset) + InLen <= StringPoolSize))
+	{
+		FUTF8ToTCHAR Converter(reinterpret_cast<const ANSICHAR*>(StringPool + InOffset), InLen);
+		String.AppendChars(Converter.Get(), Converter.Length());
+	}
+	return String;
+}
+
+FString FPlasticSourceControlCacheSnapshot::GetFilename(const int32 InIndex) const
+{
+	check((InIndex >= 0) && (InIndex < NbRecords));
+	return GetPoolString(Records[InIndex].LocalFilename.Offset, Records[InIndex].LocalFilename.Len);
+}
+
+FPlasticSourceControlState FPlasticSourceControlCacheSnapshot::GetState(const int32 InIndex) const
+{
+	check((InIndex >= 0) && (InIndex < NbRecords));
+	const FPlasticSnapshotRecord& Record = Records[InIndex];
+	FPlasticSourceControlState State(GetFilename(InIndex));
+	State.WorkspaceState = (Record.WorkspaceState <= EWorkspaceState::Private) ? static_cast<EWorkspaceState::Type>(Record.WorkspaceState) : EWorkspaceState::Unknown;
+	State.LocalRevisionChangeset = Record.LocalRevisionChangeset;
+	State.DepotRevisionChangeset = Record.DepotRevisionChangeset;
+	State.LockedBy = GetPoolString(Record.LockedBy.Offset, Record.LockedBy.Len);
+	State.LockedWhere = GetPoolString(Record.LockedWhere.Offset, Record.LockedWhere.Len);
+	State.PendingMergeBaseFileHash = GetPoolString(Record.PendingMergeBaseFileHash.Offset, Record.PendingMergeBaseFileHash.Len);
+	State.MovedFrom = GetPoolString(Record.MovedFrom.Offset, Record.MovedFrom.Len);
+	return State;
+}
+
+int32 FPlasticSourceControlCacheSnapshot::Find(const FString& InFilename) const
+{
+	if (NbRecords == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Binary search directly in the mapped path table: only the pages of the visited entries are loaded
+	FTCHARToUTF8 Converter(*InFilename.ToLower());
+	const uint8* Path = reinterpret_cast<const uint8*>(Converter.Get());
+	const uint32 PathLen = Converter.Length();
+	int32 Low = 0;
+	int32 High = NbRecords - 1;
+	while (Low <= High)
+	{
+		const int32 Middle = Low + (High - Low) / 2;
+		const FPlasticSnapshotPoolString& Entry = PathTable[Middle];
+		if (static_cast<uint64>(Entry.Offset) + Entry.Len > StringPoolSize)
+		{
+			return INDEX_NONE; // corrupted entry
+		}
+		const int32 Result = ComparePaths(StringPool + Entry.Offset, Entry.Len, Path, PathLen);
+		if (Result == 0)
+		{
+			return Middle;
+		}
+		else if (Result < 0)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle - 1;
+		}
+	}
+	return INDEX_NONE;
+}
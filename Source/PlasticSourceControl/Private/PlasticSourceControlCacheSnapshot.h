@@ -0,0 +1,111 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+#include "PlasticSourceControlState.h"
+
+/**
+ * Snapshot of the state cache of the provider persisted to disk at shutdown, to be loaded at start-up
+ * so that the Editor shows the right icons and menus right away, before the states are reconciled in background.
+ *
+ * The file is memory-mapped and looked up in place, so that start-up only touches the pages actually needed,
+ * whatever the size of the workspace. Native little-endian layout, all fields 4-byte aligned:
+ * - a fixed header (magic, version, workspace changeset, number of records, offsets of the sections below)
+ * - a path table, sorted by the UTF-8 bytes of the lower case paths (case-insensitive, like the keys of the state cache),
+ *   each entry referencing its lower case path in the string pool
+ * - fixed-width state records, in the same order as the path table, referencing the actual path of their file
+ * - a string pool of UTF-8 strings, where user names, workspace names and hashes are stored only once
+ */
+class FPlasticSourceControlCacheSnapshot
+{
+public:
+	FPlasticSourceControlCacheSnapshot();
+	~FPlasticSourceControlCacheSnapshot();
+
+	/** Path to the snapshot file, in the Saved directory of the project */
+	static FString GetFilename();
+
+	/**
+	 * Save the state (workspace state, revisions, locks and origin of moves) of all the files of the cache,
+	 * along with the files of the given snapshot not (yet) in the cache and still on disk
+	 * (without their revisions if the snapshot was taken at another changeset)
+	 * @param	InFilename			Path to the snapshot file
+	 * @param	InWorkspaceRoot		The root of the workspace, the snapshot being discarded when loaded for another one
+	 * @param	InChangeset			The changeset of the workspace, to tag the snapshot with
+	 * @param	InStateCache		The state cache of the provider
+	 * @param	InOutSnapshot		The snapshot loaded at start-up (if any), closed before its file is overwritten
+	 * @returns true if the snapshot has been written
+	 */
+	static bool Save(const FString& InFilename, const FString& InWorkspaceRoot, const int32 InChangeset, const TMap<FString, TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> >& InStateCache, FPlasticSourceControlCacheSnapshot& InOutSnapshot);
+
+	/**
+	 * Map the snapshot file in memory, checking its header
+	 * @param	InFilename			Path to the snapshot file
+	 * @param	InWorkspaceRoot		The root of the workspace, to check that the snapshot belongs to it
+	 * @returns true if a valid snapshot of the workspace has been opened
+	 */
+	bool Open(const FString& InFilename, const FString& InWorkspaceRoot);
+
+	/** Unmap the snapshot file */
+	void Close();
+
+	/** Is a snapshot file mapped */
+	inline bool IsOpen() const
+	{
+		return (Data != nullptr);
+	}
+
+	/** Changeset of the workspace when the snapshot was saved */
+	inline int32 GetChangeset() const
+	{
+		return Changeset;
+	}
+
+	/** Number of files in the snapshot */
+	inline int32 Num() const
+	{
+		return NbRecords;
+	}
+
+	/** Get the path of a file of the snapshot, by index */
+	FString GetFilename(const int32 InIndex) const;
+
+	/** Get the state of a file of the snapshot, by index */
+	FPlasticSourceControlState GetState(const int32 InIndex) const;
+
+	/**
+	 * Find the state of a file by a binary search in the path table of the mapped file, ignoring the case of the path
+	 * @returns the index of the file in the snapshot, or INDEX_NONE if not found
+	 */
+	int32 Find(const FString& InFilename) const;
+
+private:
+	/** Decode a string of the string pool */
+	FString GetPoolString(const uint32 InOffset, const uint32 InLen) const;
+
+	/** Begin of the mapped file (or of the buffer it has been read into, on platforms without memory mapping) */
+	const uint8* Data;
+
+	/** Size of the mapped file */
+	int64 DataSize;
+
+	/** Changeset of the workspace when the snapshot was saved */
+	int32 Changeset;
+
+	/** Number of files in the snapshot */
+	int32 NbRecords;
+
+	/** Sections of the mapped file */
+	const struct FPlasticSnapshotPoolString* PathTable;
+	const struct FPlasticSnapshotRecord* Records;
+	const uint8* StringPool;
+	uint32 StringPoolSize;
+
+#if PLATFORM_WINDOWS
+	/** File and file mapping handles */
+	void* FileHandle;
+	void* MappingHandle;
+#endif
+	/** Content of the file, on platforms without memory mapping */
+	TArray<uint8> Buffer;
+};
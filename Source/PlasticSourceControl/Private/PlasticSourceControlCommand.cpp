@@ -5,16 +5,21 @@
 #include "PlasticSourceControlModule.h"
 #include "PlasticSourceControlProvider.h"
 #include "IPlasticSourceControlWorker.h"
+#include "PlasticSourceControlUtils.h"
 
 FPlasticSourceControlCommand::FPlasticSourceControlCommand(const TSharedRef<class ISourceControlOperation, ESPMode::ThreadSafe>& InOperation, const TSharedRef<class IPlasticSourceControlWorker, ESPMode::ThreadSafe>& InWorker, const FSourceControlOperationComplete& InOperationCompleteDelegate)
 	: Operation(InOperation)
 	, Worker(InWorker)
 	, OperationCompleteDelegate(InOperationCompleteDelegate)
 	, bExecuteProcessed(0)
+	, bCancelled(0)
 	, bCommandSuccessful(false)
 	, bConnectionDropped(false)
 	, bAutoDelete(true)
 	, Concurrency(EConcurrency::Synchronous)
+	, Priority(EPlasticCommandPriority::Interactive)
+	, QueuedTimestamp(0.0)
+	, WatcherGeneration(0)
 {
 	// grab the providers settings here, so we don't access them once the worker thread is launched
 	check(IsInGameThread());
@@ -24,7 +29,23 @@ FPlasticSourceControlCommand::FPlasticSourceControlCommand(const TSharedRef<clas
 
 bool FPlasticSourceControlCommand::DoWork()
 {
-	bCommandSuccessful = Worker->Execute(*this);
+	if (IsCanceled())
+	{
+		// cancelled while still waiting in the queue: no need to run it
+		bCommandSuccessful = false;
+	}
+	else
+	{
+		// abort the Plastic commands run on behalf of this operation as soon as it is cancelled
+		FScopedPlasticCancellation Cancellation(&bCancelled);
+		// and let a background command yield to interactive ones between its chunks, the last free 'cm shell' being reserved to the latter
+		FScopedPlasticCommandPriority CommandPriority(Priority);
+		bCommandSuccessful = Worker->Execute(*this);
+	}
+	if (Priority == EPlasticCommandPriority::Interactive)
+	{
+		PlasticSourceControlUtils::EndInteractiveCommand();
+	}
 	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
 
 	return bCommandSuccessful;
@@ -32,6 +53,10 @@ bool FPlasticSourceControlCommand::DoWork()
 
 void FPlasticSourceControlCommand::Abandon()
 {
+	if (Priority == EPlasticCommandPriority::Interactive)
+	{
+		PlasticSourceControlUtils::EndInteractiveCommand();
+	}
 	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
 }
 
@@ -40,3 +65,13 @@ void FPlasticSourceControlCommand::DoThreadedWork()
 	Concurrency = EConcurrency::Asynchronous;
 	DoWork();
 }
+
+void FPlasticSourceControlCommand::Cancel()
+{
+	FPlatformAtomics::InterlockedExchange(&bCancelled, 1);
+}
+
+bool FPlasticSourceControlCommand::IsCanceled() const
+{
+	return bCancelled != 0;
+}
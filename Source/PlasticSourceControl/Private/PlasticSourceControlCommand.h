@@ -2,6 +2,17 @@
 
 #pragma once
 
+/** Priority classes of the commands, from the most to the least urgent */
+namespace EPlasticCommandPriority
+{
+	enum Type
+	{
+		Interactive,		// someone is waiting on it (synchronous operations, explicit user actions)
+		ForegroundRefresh,	// refresh of the states displayed by the Editor
+		Background,			// prefetch and reconciliation of the cache
+	};
+}
+
 /**
  * Used to execute Plastic commands multi-threaded.
  */
@@ -31,6 +42,12 @@ public:
 	 */ 
 	virtual void DoThreadedWork() override;
 
+	/** Attempt to cancel the operation */
+	void Cancel();
+
+	/** Is the operation canceled? */
+	bool IsCanceled() const;
+
 public:
 	/** Path to the root of the Plastic workspace: can be the GameDir itself, or any parent directory (found by the "Connect" operation) */
 	FString PathToWorkspaceRoot;
@@ -44,9 +61,15 @@ public:
 	/** Delegate to notify when this operation completes */
 	FSourceControlOperationComplete OperationCompleteDelegate;
 
+	/** Identical requests issued while this command was in flight, attached to it instead of running again (notified when it completes) */
+	TArray< TPair<FSourceControlOperationRef, FSourceControlOperationComplete> > Followers;
+
 	/**If true, this command has been processed by the source control thread*/
 	volatile int32 bExecuteProcessed;
 
+	/**If true, this command has been cancelled*/
+	volatile int32 bCancelled;
+
 	/**If true, the source control command succeeded*/
 	bool bCommandSuccessful;
 
@@ -59,6 +82,15 @@ public:
 	/** Whether we are running multi-treaded or not*/
 	EConcurrency::Type Concurrency;
 
+	/** Priority class of the command, used by the scheduler of the provider */
+	EPlasticCommandPriority::Type Priority;
+
+	/** When the command has been queued in the scheduler, for its aging */
+	double QueuedTimestamp;
+
+	/** Generation of the changes of the workspace watcher when the command has been dispatched, to trust only the results more recent than any change */
+	uint64 WatcherGeneration;
+
 	/** Files to perform this operation on */
 	TArray< FString > Files;
 
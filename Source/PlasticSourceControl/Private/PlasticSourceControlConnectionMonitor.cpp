@@ -0,0 +1,163 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlConnectionMonitor.h"
+#include "PlasticSourceControlUtils.h"
+
+namespace PlasticConnectionMonitorConstants
+{
+	/** Delay between two heartbeats while the server is reachable, in seconds */
+	static const double ReachablePeriod = 30.0;
+
+	/** Delay between two heartbeats while the server is unreachable, to notice quickly when it is back, in seconds */
+	static const double UnreachablePeriod = 5.0;
+
+	/** Minimum delay between two checks requested after failures of commands, in seconds */
+	static const double MinRequestPeriod = 1.0;
+}
+
+FPlasticSourceControlConnectionMonitor::FPlasticSourceControlConnectionMonitor()
+	: bHasStatus(false)
+	, bReachable(false)
+	, Latency(0.0)
+	, LastCheckTimestamp(0.0)
+	, Thread(nullptr)
+	, WakeUpEvent(nullptr)
+{
+}
+
+FPlasticSourceControlConnectionMonitor::~FPlasticSourceControlConnectionMonitor()
+{
+	Terminate();
+}
+
+void FPlasticSourceControlConnectionMonitor::Launch(const FString& InWorkspaceRoot)
+{
+	if (Thread == nullptr)
+	{
+		WorkspaceRoot = InWorkspaceRoot;
+		// The first heartbeat is one period away: the "Connect" operation executed at load time reports its own check meanwhile
+		LastCheckTimestamp = FPlatformTime::Seconds();
+		StopTaskCounter.Reset();
+		{
+			FScopeLock ScopeLock(&CriticalSection);
+			WakeUpEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		}
+		Thread = FRunnableThread::Create(this, TEXT("PlasticSourceControlConnectionMonitor"), 0, TPri_BelowNormal);
+	}
+}
+
+void FPlasticSourceControlConnectionMonitor::Terminate()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true); // calls Stop() then waits for Run() to return
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FScopeLock ScopeLock(&CriticalSection);
+	// under the lock, since workers can request a check at any time
+	if (WakeUpEvent != nullptr)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
+		WakeUpEvent = nullptr;
+	}
+	bHasStatus = false;
+	bReachable = false;
+	Latency = 0.0;
+}
+
+bool FPlasticSourceControlConnectionMonitor::HasStatus() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return bHasStatus;
+}
+
+bool FPlasticSourceControlConnectionMonitor::IsReachable() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return bReachable;
+}
+
+double FPlasticSourceControlConnectionMonitor::GetLatency() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return Latency;
+}
+
+void FPlasticSourceControlConnectionMonitor::ReportStatus(const bool bInReachable, const double InLatency)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	if (!bHasStatus || (bReachable != bInReachable))
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Connection to the server: %s (%lfs)"), bInReachable ? TEXT("reachable") : TEXT("unreachable"), InLatency);
+	}
+	bHasStatus = true;
+	bReachable = bInReachable;
+	if (bInReachable)
+	{
+		Latency = InLatency;
+	}
+	LastCheckTimestamp = FPlatformTime::Seconds();
+}
+
+void FPlasticSourceControlConnectionMonitor::RequestCheck()
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	if (WakeUpEvent != nullptr)
+	{
+		WakeUpEvent->Trigger();
+	}
+}
+
+uint32 FPlasticSourceControlConnectionMonitor::Run()
+{
+	while (StopTaskCounter.GetValue() == 0)
+	{
+		double Period;
+		double SinceLastCheck;
+		{
+			FScopeLock ScopeLock(&CriticalSection);
+			Period = (!bHasStatus || bReachable) ? PlasticConnectionMonitorConstants::ReachablePeriod : PlasticConnectionMonitorConstants::UnreachablePeriod;
+			SinceLastCheck = FPlatformTime::Seconds() - LastCheckTimestamp;
+		}
+		if (SinceLastCheck >= Period)
+		{
+			CheckConnection();
+		}
+		else
+		{
+			const bool bWokenUp = WakeUpEvent->Wait(static_cast<uint32>((Period - SinceLastCheck) * 1000.0) + 1);
+			// Early check requested after the failure of a command, but not more than once in a while
+			if (bWokenUp && (StopTaskCounter.GetValue() == 0) && (SinceLastCheck >= PlasticConnectionMonitorConstants::MinRequestPeriod))
+			{
+				CheckConnection();
+			}
+		}
+	}
+	return 0;
+}
+
+void FPlasticSourceControlConnectionMonitor::Stop()
+{
+	StopTaskCounter.Increment();
+	FScopeLock ScopeLock(&CriticalSection);
+	if (WakeUpEvent != nullptr)
+	{
+		WakeUpEvent->Trigger();
+	}
+}
+
+void FPlasticSourceControlConnectionMonitor::CheckConnection()
+{
+	TArray<FString> Files;
+	Files.Add(WorkspaceRoot);
+	TArray<FString> InfoMessages;
+	TArray<FString> ErrorMessages;
+	// the heartbeat never takes the 'cm shell' reserved to interactive commands
+	FScopedPlasticCommandPriority CommandPriority(EPlasticCommandPriority::Background);
+	const double StartTimestamp = FPlatformTime::Seconds();
+	const bool bResult = PlasticSourceControlUtils::RunCommand(TEXT("checkconnection"), TArray<FString>(), Files, InfoMessages, ErrorMessages);
+	ReportStatus(bResult, FPlatformTime::Seconds() - StartTimestamp);
+}
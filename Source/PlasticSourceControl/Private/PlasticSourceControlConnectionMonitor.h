@@ -0,0 +1,80 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+/**
+ * Connection health monitor: a background thread running a periodic 'checkconnection' heartbeat,
+ * caching the reachability of the server and the latency of the check.
+ *
+ * Workers consult the cached reachability instead of running their own 'checkconnection' before and after each command,
+ * and only ask for an early heartbeat when a command fails.
+ */
+class FPlasticSourceControlConnectionMonitor : public FRunnable
+{
+public:
+	FPlasticSourceControlConnectionMonitor();
+	virtual ~FPlasticSourceControlConnectionMonitor();
+
+	/**
+	 * Start the heartbeat thread (if not already running)
+	 * @param	InWorkspaceRoot		The root of the workspace, to check the connection to its server
+	 */
+	void Launch(const FString& InWorkspaceRoot);
+
+	/** Stop the heartbeat thread, wait for its termination and forget about the reachability of the server */
+	void Terminate();
+
+	/** Has the reachability of the server been checked at least once */
+	bool HasStatus() const;
+
+	/** Is the server reachable, as of the last check */
+	bool IsReachable() const;
+
+	/** Duration of the last successful check, in seconds */
+	double GetLatency() const;
+
+	/**
+	 * Record the result of a check of the connection done by someone else (like the "Connect" operation), postponing the next heartbeat
+	 * @param	bInReachable		Has the server been reached
+	 * @param	InLatency			Duration of the check, in seconds
+	 */
+	void ReportStatus(const bool bInReachable, const double InLatency);
+
+	/** Wake up the heartbeat thread to check the connection right away (after the failure of a command) */
+	void RequestCheck();
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Run a 'checkconnection' command and record its result */
+	void CheckConnection();
+
+	/** Critical section protecting the status of the connection, and the wake up event against its release by Terminate() */
+	mutable FCriticalSection CriticalSection;
+
+	/** The root of the workspace */
+	FString WorkspaceRoot;
+
+	/** Has the reachability of the server been checked at least once */
+	bool bHasStatus;
+
+	/** Is the server reachable, as of the last check */
+	bool bReachable;
+
+	/** Duration of the last successful check, in seconds */
+	double Latency;
+
+	/** Timestamp of the last check */
+	double LastCheckTimestamp;
+
+	/** The heartbeat thread */
+	FRunnableThread* Thread;
+
+	/** Event used to wake up the heartbeat thread early, to stop it or for an early check */
+	FEvent* WakeUpEvent;
+
+	/** Set to stop the heartbeat thread */
+	FThreadSafeCounter StopTaskCounter;
+};
@@ -22,13 +22,23 @@ bool FPlasticConnectWorker::Execute(FPlasticSourceControlCommand& InCommand)
 
 	UE_LOG(LogSourceControl, Log, TEXT("connect"));
 
-	// Execute a 'status' command to check for the workspace
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("--nochanges"));
-	TArray<FString> Files;
-	Files.Add(InCommand.PathToWorkspaceRoot);
+	// Execute a 'status' command to check for the workspace,
+	// and right after it, without waiting for its result, a 'checkconnection' command to check the connectivity of the server
+	// (in the same exchange as the version and user, if not already known)
+	FPlasticProbe Probe;
+	Probe.bGetWorkspaceStatus = true;
+	Probe.bCheckConnection = true;
+	const double StartTimestamp = FPlatformTime::Seconds();
+	PlasticSourceControlUtils::RunProbe(InCommand.PathToWorkspaceRoot, Probe);
+	if(Probe.bWorkspaceStatusOk)
+	{
+		// seed the connection health monitor, that then takes over with its heartbeat
+		PlasticSourceControlUtils::ReportConnectionStatus(Probe.bConnectionOk, FPlatformTime::Seconds() - StartTimestamp);
+	}
 
-	InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunCommand(TEXT("status"), Parameters, Files, InCommand.InfoMessages, InCommand.ErrorMessages);
+	InCommand.bCommandSuccessful = Probe.bWorkspaceStatusOk;
+	InCommand.InfoMessages.Append(Probe.WorkspaceStatusMessages);
+	InCommand.ErrorMessages.Append(Probe.WorkspaceStatusErrors);
 	if(!InCommand.bCommandSuccessful || InCommand.ErrorMessages.Num() > 0 || InCommand.InfoMessages.Num() == 0)
 	{
 		Operation->SetErrorText(LOCTEXT("NotAPlasticRepository", "Failed to enable Plastic source control. You need to initialize the project as a Plastic repository first."));
@@ -36,8 +46,9 @@ bool FPlasticConnectWorker::Execute(FPlasticSourceControlCommand& InCommand)
 	}
 	else
 	{
-		// Execute a 'checkconnection' command to check the connectivity of the server.
-		InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunCommand(TEXT("checkconnection"), TArray<FString>(), Files, InCommand.InfoMessages, InCommand.ErrorMessages);
+		InCommand.bCommandSuccessful = Probe.bConnectionOk;
+		InCommand.InfoMessages.Append(Probe.ConnectionMessages);
+		InCommand.ErrorMessages.Append(Probe.ConnectionErrors);
 		if (!InCommand.bCommandSuccessful || InCommand.ErrorMessages.Num() > 0 || InCommand.InfoMessages.Num() == 0)
 		{
 			Operation->SetErrorText(FText::FromString(InCommand.ErrorMessages[0]));
@@ -233,12 +244,8 @@ bool FPlasticUpdateStatusWorker::Execute(FPlasticSourceControlCommand& InCommand
 
 	if (InCommand.Files.Num() > 0)
 	{
-		{
-			// Execute beforehand a 'checkconnection' command to check the connectivity of the server.
-			TArray<FString> Files;
-			Files.Add(InCommand.PathToWorkspaceRoot);
-			InCommand.bConnectionDropped = !PlasticSourceControlUtils::RunCommand(TEXT("checkconnection"), TArray<FString>(), Files, InCommand.InfoMessages, InCommand.ErrorMessages);
-		}
+		// Consult the connectivity of the server cached by the connection health monitor, instead of a 'checkconnection' round trip
+		InCommand.bConnectionDropped = !PlasticSourceControlUtils::IsConnectionAlive();
 		if (!InCommand.bConnectionDropped)
 		{
 			InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunUpdateStatus(InCommand.Files, InCommand.ErrorMessages, States);
@@ -246,10 +253,8 @@ bool FPlasticUpdateStatusWorker::Execute(FPlasticSourceControlCommand& InCommand
 		}
 		if (!InCommand.bCommandSuccessful)
 		{
-			// In case of error, execute a 'checkconnection' command to check the connectivity of the server.
-			TArray<FString> Files;
-			Files.Add(InCommand.PathToWorkspaceRoot);
-			InCommand.bConnectionDropped = !PlasticSourceControlUtils::RunCommand(TEXT("checkconnection"), TArray<FString>(), Files, InCommand.InfoMessages, InCommand.ErrorMessages);
+			// In case of error, have the connection health monitor check the connectivity of the server right away, without waiting for it
+			PlasticSourceControlUtils::RequestConnectionCheck();
 		}
 		else
 		{
@@ -272,16 +277,23 @@ bool FPlasticUpdateStatusWorker::Execute(FPlasticSourceControlCommand& InCommand
 	}
 	else
 	{
-		UE_LOG(LogSourceControl, Log, TEXT("status (with no files)"));
-		InCommand.bCommandSuccessful = true;
-		// Perforce "opened files" are those that have been modified (or added/deleted): that is what we get with a simple Plastic status from the root
-		if (Operation->ShouldGetOpenedOnly())
+		// Perforce "opened files" are those that have been modified (or added/deleted): that is what we get with a simple Plastic status from the root,
+		// so a request without any file (or for the opened files only) runs a single recursive status over the whole project directory
+		const FString ProjectDir = FPaths::ConvertRelativePathToFull(FPaths::GameDir());
+		UE_LOG(LogSourceControl, Log, TEXT("status (with no files) of '%s'"), *ProjectDir);
+		InCommand.bConnectionDropped = !PlasticSourceControlUtils::IsConnectionAlive();
+		if (!InCommand.bConnectionDropped)
+		{
+			InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunWorkspaceStatus(ProjectDir, InCommand.ErrorMessages, States);
+		}
+		if (InCommand.bCommandSuccessful)
 		{
-			/** TODO: UpdateStatus() from the ContentDir()
-			TArray<FString> Files;
-			Files.Add(FPaths::ConvertRelativePathToFull(FPaths::GameDir()));
-			InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunUpdateStatus(Files, InCommand.ErrorMessages, States);
-			*/
+			// only on success, since all the other files of the subtree are then known to be Controlled
+			Subtree = ProjectDir;
+		}
+		else
+		{
+			PlasticSourceControlUtils::RequestConnectionCheck();
 		}
 	}
 
@@ -292,7 +304,16 @@ bool FPlasticUpdateStatusWorker::Execute(FPlasticSourceControlCommand& InCommand
 
 bool FPlasticUpdateStatusWorker::UpdateStates() const
 {
-	bool bUpdated = PlasticSourceControlUtils::UpdateCachedStates(States);
+	bool bUpdated;
+	if (Subtree.IsEmpty())
+	{
+		bUpdated = PlasticSourceControlUtils::UpdateCachedStates(States);
+	}
+	else
+	{
+		// The status of a whole subtree only reports the files with changes
+		bUpdated = PlasticSourceControlUtils::UpdateCachedWorkspaceStates(Subtree, States);
+	}
 
 	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
 	FPlasticSourceControlProvider& Provider = PlasticSourceControl.GetProvider();
@@ -309,6 +330,41 @@ bool FPlasticUpdateStatusWorker::UpdateStates() const
 	return bUpdated;
 }
 
+FName FPlasticPrefetchStatusWorker::GetName() const
+{
+	return "PrefetchStatus";
+}
+
+bool FPlasticPrefetchStatusWorker::Execute(FPlasticSourceControlCommand& InCommand)
+{
+	check(InCommand.Operation->GetName() == GetName());
+	TSharedRef<FPlasticPrefetchStatus, ESPMode::ThreadSafe> Operation = StaticCastSharedRef<FPlasticPrefetchStatus>(InCommand.Operation);
+
+	InCommand.bConnectionDropped = !PlasticSourceControlUtils::IsConnectionAlive();
+	if (!InCommand.bConnectionDropped)
+	{
+		InCommand.bCommandSuccessful = PlasticSourceControlUtils::RunWorkspacePrefetch(InCommand.PathToWorkspaceRoot, InCommand.ErrorMessages, States);
+	}
+	if (!InCommand.bCommandSuccessful)
+	{
+		PlasticSourceControlUtils::RequestConnectionCheck();
+	}
+
+	// the files whose state has been read, to be trusted by the workspace watcher
+	Operation->Files.Reserve(States.Num());
+	for (const FPlasticSourceControlState& State : States)
+	{
+		Operation->Files.Add(State.LocalFilename);
+	}
+
+	return InCommand.bCommandSuccessful;
+}
+
+bool FPlasticPrefetchStatusWorker::UpdateStates() const
+{
+	return PlasticSourceControlUtils::UpdateCachedStates(States);
+}
+
 FName FPlasticCopyWorker::GetName() const
 {
 	return "Copy";
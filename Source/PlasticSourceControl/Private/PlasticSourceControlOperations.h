@@ -8,6 +8,28 @@
 #include "PlasticSourceControlState.h"
 #include "PlasticSourceControlRevision.h"
 
+/**
+ * Operation of the plugin itself (not one of the Engine): prefetch in background the state of all the files of the workspace,
+ * telling the files whose state has been read.
+ */
+class FPlasticPrefetchStatus : public ISourceControlOperation
+{
+public:
+	// ISourceControlOperation interface
+	virtual FName GetName() const override
+	{
+		return "PrefetchStatus";
+	}
+
+	virtual FText GetInProgressString() const override
+	{
+		return NSLOCTEXT("PlasticSourceControl", "SourceControl_PrefetchStatus", "Prefetching the status of the workspace...");
+	}
+
+	/** The files whose state has been read */
+	TArray<FString> Files;
+};
+
 /** Called when first activated on a project, and then at project load time.
  *  Look for the root directory of the Plastic workspace (where the ".plastic/" subdirectory is located). */
 class FPlasticConnectWorker : public IPlasticSourceControlWorker
@@ -125,6 +147,24 @@ public:
 
 	/** Map of filenames to history */
 	TMap<FString, TPlasticSourceControlHistory> Histories;
+
+	/** Root of the subtree of a recursive status (when requested without any file), whose other files in cache are thus Controlled */
+	FString Subtree;
+};
+
+/** Prefetch the state of all the files of the workspace (see FPlasticPrefetchStatus) */
+class FPlasticPrefetchStatusWorker : public IPlasticSourceControlWorker
+{
+public:
+	virtual ~FPlasticPrefetchStatusWorker() {}
+	// IPlasticSourceControlWorker interface
+	virtual FName GetName() const override;
+	virtual bool Execute(class FPlasticSourceControlCommand& InCommand) override;
+	virtual bool UpdateStates() const override;
+
+public:
+	/** Temporary states for results */
+	TArray<FPlasticSourceControlState> States;
 };
 
 /** Copy or Move operation on a single file */
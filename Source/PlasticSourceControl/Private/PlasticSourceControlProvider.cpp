@@ -16,59 +16,258 @@
 
 static FName ProviderName("Plastic SCM");
 
+namespace PlasticWorkspaceWatcherConstants
+{
+	/** Delay between two refreshes of the files changed on disk, to batch the changes of a burst (like a save or an update), in seconds */
+	static const double DirtyRefreshPeriod = 1.0;
+}
+
 void FPlasticSourceControlProvider::Init(bool bForceConnection)
 {
-	CheckPlasticAvailability(bForceConnection);
+	CheckPlasticAvailabilityAsync();
+	LoadStateCacheSnapshot();
+}
+
+/**
+ * Read the workspace name, repository, server and branch from the metadata files of the workspace, without running any cm command
+ * @returns true if they have all been found
+ */
+static bool ReadWorkspaceMetadata(const FString& InPathToWorkspaceRoot, FPlasticAvailability& OutAvailability)
+{
+	const bool bNameFound = PlasticSourceControlUtils::ReadWorkspaceName(InPathToWorkspaceRoot, OutAvailability.WorkspaceName);
+	const bool bSelectorFound = PlasticSourceControlUtils::ReadWorkspaceSelector(InPathToWorkspaceRoot, OutAvailability.RepositoryName, OutAvailability.ServerUrl, OutAvailability.BranchName);
+	return bNameFound && bSelectorFound;
+}
+
+/**
+ * Launch the 'cm shell' processes and probe the Plastic binary and the workspace (can run on any thread),
+ * only asking cm for the workspace information not already read from its metadata files
+ */
+static FPlasticAvailability ProbePlasticAvailability(const FString& InPathToPlasticBinary, const FString& InPathToWorkspaceRoot, const bool bInWorkspaceFound, const int32 InShellPoolSize, const FPlasticAvailability& InWorkspaceMetadata)
+{
+	FPlasticAvailability Availability = InWorkspaceMetadata;
+
+	if(!InPathToPlasticBinary.IsEmpty())
+	{
+		Availability.bPlasticAvailable = PlasticSourceControlUtils::LaunchBackgroundPlasticShell(InPathToPlasticBinary, InPathToWorkspaceRoot, InShellPoolSize);
+		if(Availability.bPlasticAvailable)
+		{
+			// Get version and user name (from the global Plastic SCM client config), and if needed
+			// workspace, repository, server and branch name (fallback if the metadata files are missing or in an unknown format),
+			// all in one pipelined exchange with cm
+			FPlasticProbe Probe;
+			if(bInWorkspaceFound)
+			{
+				Probe.bGetWorkspaceName = Availability.WorkspaceName.IsEmpty();
+				// always get the workspace status, for the changeset to check the cache snapshot against
+				Probe.bGetWorkspaceStatus = true;
+				Probe.bGetBranchName = Availability.BranchName.IsEmpty();
+				// Note: no "checkconnection" at this stage, "Connect" is already the first operation executed by the Editor Toolbar at load time
+			}
+			else
+			{
+				UE_LOG(LogSourceControl, Error, TEXT("'%s' is not part of a Plastic workspace"), *FPaths::GameDir());
+			}
+			PlasticSourceControlUtils::RunProbe(InPathToWorkspaceRoot, Probe);
+
+			UE_LOG(LogSourceControl, Log, TEXT("Plastic SCM %s"), *Probe.PlasticScmVersion);
+			Availability.UserName = Probe.UserName;
+			if(Probe.bGetWorkspaceName)
+			{
+				Availability.WorkspaceName = Probe.WorkspaceName;
+			}
+			if(Probe.bGetWorkspaceStatus)
+			{
+				Availability.Changeset = Probe.Changeset;
+				if(Availability.BranchName.IsEmpty())
+				{
+					Availability.RepositoryName = Probe.RepositoryName;
+					Availability.ServerUrl = Probe.ServerUrl;
+				}
+			}
+			if(Probe.bGetBranchName)
+			{
+				Availability.BranchName = Probe.BranchName;
+			}
+		}
+	}
+
+	return Availability;
 }
 
 void FPlasticSourceControlProvider::CheckPlasticAvailability(bool bForceConnection)
 {
+	// Finish any check still running in background before starting a new one
+	WaitForPlasticAvailability();
+
 	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
 	const FString& PathToPlasticBinary = PlasticSourceControl.AccessSettings().GetBinaryPath();
+	const int32 ShellPoolSize = PlasticSourceControl.AccessSettings().GetShellPoolSize();
+	MaxScheduledCommands = FMath::Max(1, ShellPoolSize - 1);
 
 	// Find the path to the root Plastic directory (if any, else uses the GameDir)
 	const FString PathToGameDir = FPaths::ConvertRelativePathToFull(FPaths::GameDir());
 	bWorkspaceFound = PlasticSourceControlUtils::FindRootDirectory(PathToGameDir, PathToWorkspaceRoot);
 
-	if(!PathToPlasticBinary.IsEmpty())
+	FPlasticAvailability WorkspaceMetadata;
+	if(bWorkspaceFound)
+	{
+		ReadWorkspaceMetadata(PathToWorkspaceRoot, WorkspaceMetadata);
+	}
+
+	ApplyPlasticAvailability(ProbePlasticAvailability(PathToPlasticBinary, PathToWorkspaceRoot, bWorkspaceFound, ShellPoolSize, WorkspaceMetadata));
+}
+
+void FPlasticSourceControlProvider::CheckPlasticAvailabilityAsync()
+{
+	// Finish any check still running in background before starting a new one
+	WaitForPlasticAvailability();
+
+	// Hold the commands issued from now on until the identity of the workspace is known (see ApplyPlasticAvailability)
+	bConnecting = true;
+
+	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
+	const FString PathToPlasticBinary = PlasticSourceControl.AccessSettings().GetBinaryPath();
+	const int32 ShellPoolSize = PlasticSourceControl.AccessSettings().GetShellPoolSize();
+	MaxScheduledCommands = FMath::Max(1, ShellPoolSize - 1);
+
+	// Find the path to the root Plastic directory (if any, else uses the GameDir): only a quick look at the file system,
+	// so that the path is known right away by the commands issued meanwhile
+	const FString PathToGameDir = FPaths::ConvertRelativePathToFull(FPaths::GameDir());
+	bWorkspaceFound = PlasticSourceControlUtils::FindRootDirectory(PathToGameDir, PathToWorkspaceRoot);
+
+	// Read the workspace identity from its metadata files, so that it is displayed right away
+	FPlasticAvailability WorkspaceMetadata;
+	if(bWorkspaceFound && ReadWorkspaceMetadata(PathToWorkspaceRoot, WorkspaceMetadata))
 	{
-		bPlasticAvailable = PlasticSourceControlUtils::LaunchBackgroundPlasticShell(PathToPlasticBinary, PathToWorkspaceRoot);
-		if(bPlasticAvailable)
+		WorkspaceName = WorkspaceMetadata.WorkspaceName;
+		RepositoryName = WorkspaceMetadata.RepositoryName;
+		ServerUrl = WorkspaceMetadata.ServerUrl;
+		BranchName = WorkspaceMetadata.BranchName;
+	}
+
+	// Then launch cm and probe it on a dedicated thread (not on the thread pool, shared with the rest of the Editor)
+	const FString PathToWorkspace = PathToWorkspaceRoot;
+	const bool bFound = bWorkspaceFound;
+	AvailabilityFuture = Async<FPlasticAvailability>(EAsyncExecution::Thread, [PathToPlasticBinary, PathToWorkspace, bFound, ShellPoolSize, WorkspaceMetadata]()
+	{
+		return ProbePlasticAvailability(PathToPlasticBinary, PathToWorkspace, bFound, ShellPoolSize, WorkspaceMetadata);
+	});
+}
+
+void FPlasticSourceControlProvider::WaitForPlasticAvailability()
+{
+	if(bConnecting)
+	{
+		AvailabilityFuture.Wait();
+		ApplyPlasticAvailability(AvailabilityFuture.Get());
+	}
+}
+
+void FPlasticSourceControlProvider::ApplyPlasticAvailability(const FPlasticAvailability& InAvailability)
+{
+	bConnecting = false;
+	AvailabilityFuture = TFuture<FPlasticAvailability>();
+
+	bPlasticAvailable = InAvailability.bPlasticAvailable;
+	if(bPlasticAvailable)
+	{
+		UserName = InAvailability.UserName;
+		if(bWorkspaceFound)
 		{
-			FString PlasticScmVersion;
-			PlasticSourceControlUtils::GetPlasticScmVersion(PlasticScmVersion);
+			WorkspaceName = InAvailability.WorkspaceName;
+			RepositoryName = InAvailability.RepositoryName;
+			ServerUrl = InAvailability.ServerUrl;
+			BranchName = InAvailability.BranchName;
+			WorkspaceChangeset = InAvailability.Changeset;
+		}
+	}
 
-			// Get user name (from the global Plastic SCM client config)
-			PlasticSourceControlUtils::GetUserName(UserName);
+	// Only dispatch the commands held during the initialization once the identity of the user and of the workspace is set,
+	// so that they never compare the locks against an empty user name (and never read it while it is being written)
+	const TArray<FPlasticSourceControlCommand*> Commands = MoveTemp(HeldCommands);
+	HeldCommands.Empty();
+	for(FPlasticSourceControlCommand* Command : Commands)
+	{
+		DispatchCommand(*Command);
+	}
+}
 
-			if(bWorkspaceFound)
-			{
-				// Get workspace, repository, server and branch name
-				PlasticSourceControlUtils::GetWorkspaceName(PathToWorkspaceRoot, WorkspaceName);
-				PlasticSourceControlUtils::GetRepositorySpecification(PathToWorkspaceRoot, RepositoryName, ServerUrl);
-				PlasticSourceControlUtils::GetBranchName(PathToWorkspaceRoot, BranchName);
-				// Note: no "checkconnection" at this stage, "Connect" is already the first operation executed by the Editor Toolbar at load time
-			}
-			else
+void FPlasticSourceControlProvider::LoadStateCacheSnapshot()
+{
+	bSnapshotStale = false;
+	SnapshotFilesToReconcile.Empty();
+	if(bWorkspaceFound)
+	{
+		// Only map the file: states are then looked up in place, one by one, as the Editor asks for them
+		Snapshot.Open(FPlasticSourceControlCacheSnapshot::GetFilename(), PathToWorkspaceRoot);
+	}
+}
+
+void FPlasticSourceControlProvider::SaveStateCacheSnapshot()
+{
+	if(bWorkspaceFound && ((StateCache.Num() > 0) || Snapshot.IsOpen()))
+	{
+		FPlasticSourceControlCacheSnapshot::Save(FPlasticSourceControlCacheSnapshot::GetFilename(), PathToWorkspaceRoot, WorkspaceChangeset, StateCache, Snapshot);
+	}
+	Snapshot.Close();
+}
+
+void FPlasticSourceControlProvider::ReconcileStateCacheSnapshot()
+{
+	if(!Snapshot.IsOpen())
+	{
+		return;
+	}
+
+	if(Snapshot.GetChangeset() != WorkspaceChangeset)
+	{
+		// The workspace has been updated (or switched) since the snapshot: revisions are stale, only keep the local states until reconciled
+		UE_LOG(LogSourceControl, Log, TEXT("State cache snapshot at cs:%d but workspace at cs:%d"), Snapshot.GetChangeset(), WorkspaceChangeset);
+		bSnapshotStale = true;
+		for(const auto& File : SnapshotFilesToReconcile)
+		{
+			TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe>* State = StateCache.Find(File);
+			if(State != nullptr)
 			{
-				UE_LOG(LogSourceControl, Error, TEXT("'%s' is not part of a Plastic workspace"), *FPaths::GameDir());
+				(*State)->LocalRevisionChangeset = -1;
+				(*State)->DepotRevisionChangeset = -1;
 			}
 		}
 	}
-	else
+
+	if(!bPlasticAvailable)
 	{
-		bPlasticAvailable = false;
+		// nothing to reconcile against
+		SnapshotFilesToReconcile.Empty();
 	}
 }
 
 void FPlasticSourceControlProvider::Close()
 {
-	// clear the cache
+	// wait for the background initialization, if still running, before terminating the 'cm shell'
+	WaitForPlasticAvailability();
+
+	StopStatusPrefetch();
+	WorkspaceWatcher.Stop();
+
+	// cancel the requests not dispatched yet
+	Scheduler.CancelAll();
+	const TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>> Requests = MoveTemp(TrustedRequests);
+	TrustedRequests.Empty();
+	for(const auto& Request : Requests)
+	{
+		Request.Value.ExecuteIfBound(Request.Key, ECommandResult::Cancelled);
+	}
+
+	// persist the cache for the next start-up, then clear it
+	SaveStateCacheSnapshot();
 	StateCache.Empty();
 	// terminate the background 'cm shell' process and associated pipes
 	PlasticSourceControlUtils::Terminate();
 
 	bServerAvailable = false;
+	bConnectSucceeded = false;
 }
 
 TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> FPlasticSourceControlProvider::GetStateInternal(const FString& Filename)
@@ -79,6 +278,23 @@ TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> FPlasticSourceContro
 		// found cached item
 		return (*State);
 	}
+	const int32 SnapshotIndex = Snapshot.Find(Filename);
+	if(SnapshotIndex != INDEX_NONE)
+	{
+		// cache the state persisted in the snapshot, to be reconciled in background
+		TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> NewState = MakeShareable( new FPlasticSourceControlState(Snapshot.GetState(SnapshotIndex)) );
+		if(bSnapshotStale)
+		{
+			NewState->LocalRevisionChangeset = -1;
+			NewState->DepotRevisionChangeset = -1;
+		}
+		StateCache.Add(Filename, NewState);
+		if(bConnecting || bPlasticAvailable)
+		{
+			SnapshotFilesToReconcile.Add(Filename);
+		}
+		return NewState;
+	}
 	else
 	{
 		// cache an unknown state for this item
@@ -88,8 +304,73 @@ TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> FPlasticSourceContro
 	}
 }
 
+void FPlasticSourceControlProvider::StartStatusPrefetch()
+{
+	if(bPrefetchStarted || !bWorkspaceFound)
+	{
+		return;
+	}
+	bPrefetchStarted = true;
+
+	// A single status of the whole workspace, and then the revisions and locks of its controlled files only, in background (see FPlasticPrefetchStatusWorker)
+	PrefetchOperation = ISourceControlOperation::Create<FPlasticPrefetchStatus>();
+	if(ExecuteWithPriority(PrefetchOperation.ToSharedRef(), TArray<FString>(), EConcurrency::Asynchronous, FSourceControlOperationComplete::CreateRaw(this, &FPlasticSourceControlProvider::OnStatusPrefetchComplete, PrefetchGeneration), EPlasticCommandPriority::Background) != ECommandResult::Succeeded)
+	{
+		PrefetchOperation.Reset();
+		bPrefetchStarted = false;
+	}
+}
+
+void FPlasticSourceControlProvider::OnStatusPrefetchComplete(const FSourceControlOperationRef& InOperation, ECommandResult::Type InResult, uint32 InGeneration)
+{
+	if(InGeneration != PrefetchGeneration)
+	{
+		// prefetch stopped since
+		return;
+	}
+
+	PrefetchOperation.Reset();
+	if(InResult == ECommandResult::Succeeded)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Status prefetch done"));
+	}
+	else if(!PlasticSourceControlUtils::IsConnectionAlive() || (InResult == ECommandResult::Cancelled))
+	{
+		// no need to insist if the connection has been lost: started again on the next successful "Connect"
+		UE_LOG(LogSourceControl, Log, TEXT("Status prefetch stopped"));
+		bPrefetchStarted = false;
+	}
+	else
+	{
+		// the states read are applied anyway, and the Editor asks for the other states it needs
+		UE_LOG(LogSourceControl, Log, TEXT("Status prefetch done, with errors"));
+	}
+}
+
+void FPlasticSourceControlProvider::StopStatusPrefetch()
+{
+	// ignore the completion of the prefetch being cancelled
+	PrefetchGeneration++;
+	if(PrefetchOperation.IsValid())
+	{
+		if(CanCancelOperation(PrefetchOperation.ToSharedRef()))
+		{
+			CancelOperation(PrefetchOperation.ToSharedRef());
+		}
+		PrefetchOperation.Reset();
+	}
+	bPrefetchStarted = false;
+}
+
 FText FPlasticSourceControlProvider::GetStatusText() const
 {
+	if(bConnecting)
+	{
+		FFormatNamedArguments Args;
+		Args.Add( TEXT("WorkspacePath"), FText::FromString(PathToWorkspaceRoot) );
+		return FText::Format( NSLOCTEXT("Status", "Provider: Plastic\nConnectingLabel", "{WorkspacePath}\nConnecting to Plastic SCM..."), Args );
+	}
+
 	FFormatNamedArguments Args;
 	Args.Add( TEXT("WorkspacePath"), FText::FromString(PathToWorkspaceRoot) );
 	Args.Add( TEXT("WorkspaceName"), FText::FromString(WorkspaceName) );
@@ -103,7 +384,8 @@ FText FPlasticSourceControlProvider::GetStatusText() const
 /** Quick check if source control is enabled */
 bool FPlasticSourceControlProvider::IsEnabled() const
 {
-	return bPlasticAvailable;
+	// enabled while connecting, so that the first commands are issued, waiting for the end of the initialization
+	return bPlasticAvailable || bConnecting;
 }
 
 /** Quick check if source control is available for use (useful for server-based providers) */
@@ -149,6 +431,7 @@ TArray<FSourceControlStateRef> FPlasticSourceControlProvider::GetCachedStateByPr
 			Result.Add(State);
 		}
 	}
+	// Note: the states of the snapshot never looked up yet are left out, as they are neither reconciled with cm nor cheap to decode all at once
 	return Result;
 }
 
@@ -157,6 +440,23 @@ bool FPlasticSourceControlProvider::RemoveFileFromCache(const FString& Filename)
 	return StateCache.Remove(Filename) > 0;
 }
 
+TArray<TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe>> FPlasticSourceControlProvider::GetCachedStatesUnder(const FString& InDirectory) const
+{
+	FString Directory = InDirectory;
+	FPaths::NormalizeDirectoryName(Directory);
+	Directory /= TEXT("");
+
+	TArray<TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe>> Result;
+	for(const auto& CacheItem : StateCache)
+	{
+		if(CacheItem.Key.StartsWith(Directory))
+		{
+			Result.Add(CacheItem.Value);
+		}
+	}
+	return Result;
+}
+
 FDelegateHandle FPlasticSourceControlProvider::RegisterSourceControlStateChanged_Handle( const FSourceControlStateChanged::FDelegate& SourceControlStateChanged )
 {
 	return OnSourceControlStateChanged.Add( SourceControlStateChanged );
@@ -168,6 +468,32 @@ void FPlasticSourceControlProvider::UnregisterSourceControlStateChanged_Handle(
 }
 
 ECommandResult::Type FPlasticSourceControlProvider::Execute( const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation, const TArray<FString>& InFiles, EConcurrency::Type InConcurrency, const FSourceControlOperationComplete& InOperationCompleteDelegate )
+{
+	// Someone is waiting on synchronous operations and on explicit actions, while asynchronous status requests refresh what the Editor displays
+	const bool bRefresh = (InConcurrency == EConcurrency::Asynchronous) && FPlasticSourceControlScheduler::IsMergeableOperation(InOperation);
+	if(bRefresh && WorkspaceWatcher.IsWatching() && (InFiles.Num() > 0) && !StaticCastSharedRef<FUpdateStatus>(InOperation)->ShouldUpdateHistory())
+	{
+		// only query cm for the files changed on disk (or never queried) since the workspace is being watched
+		TArray<FString> FilesToQuery;
+		for(const FString& File : InFiles)
+		{
+			if(!WorkspaceWatcher.IsTrusted(File) || !StateCache.Contains(File))
+			{
+				FilesToQuery.Add(File);
+			}
+		}
+		if(FilesToQuery.Num() == 0)
+		{
+			UE_LOG(LogSourceControl, Log, TEXT("Execute: %s (of %d files) answered by the cache"), *InOperation->GetName().ToString(), InFiles.Num());
+			TrustedRequests.Add(TPairInitializer<FSourceControlOperationRef, FSourceControlOperationComplete>(InOperation, InOperationCompleteDelegate));
+			return ECommandResult::Succeeded;
+		}
+		return ExecuteWithPriority(InOperation, FilesToQuery, InConcurrency, InOperationCompleteDelegate, EPlasticCommandPriority::ForegroundRefresh);
+	}
+	return ExecuteWithPriority(InOperation, InFiles, InConcurrency, InOperationCompleteDelegate, bRefresh ? EPlasticCommandPriority::ForegroundRefresh : EPlasticCommandPriority::Interactive);
+}
+
+ECommandResult::Type FPlasticSourceControlProvider::ExecuteWithPriority(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles, EConcurrency::Type InConcurrency, const FSourceControlOperationComplete& InOperationCompleteDelegate, EPlasticCommandPriority::Type InPriority, bool bInJoinInFlight)
 {
 	if(!bWorkspaceFound && !(InOperation->GetName() == "Connect")) // Only Connect operation allowed while no workspace found
 	{
@@ -186,6 +512,18 @@ ECommandResult::Type FPlasticSourceControlProvider::Execute( const TSharedRef<IS
 		return ECommandResult::Failed;
 	}
 
+	// attach an asynchronous request identical to one already in flight to its command, instead of issuing the same cm commands again
+	if(bInJoinInFlight && (InConcurrency == EConcurrency::Asynchronous))
+	{
+		FPlasticSourceControlCommand* InFlightCommand = FindIdenticalCommandInFlight(InOperation, InFiles);
+		if(InFlightCommand != nullptr)
+		{
+			UE_LOG(LogSourceControl, Log, TEXT("Execute: %s (of %d files) attached to the one in flight"), *InOperation->GetName().ToString(), InFiles.Num());
+			InFlightCommand->Followers.Add(TPairInitializer<FSourceControlOperationRef, FSourceControlOperationComplete>(InOperation, InOperationCompleteDelegate));
+			return ECommandResult::Succeeded;
+		}
+	}
+
 	FPlasticSourceControlCommand* Command = new FPlasticSourceControlCommand(InOperation, Worker.ToSharedRef());
 	Command->Files = InFiles;
 	Command->OperationCompleteDelegate = InOperationCompleteDelegate;
@@ -194,8 +532,17 @@ ECommandResult::Type FPlasticSourceControlProvider::Execute( const TSharedRef<IS
 	if(InConcurrency == EConcurrency::Synchronous)
 	{
 		Command->bAutoDelete = false;
+		Command->Priority = EPlasticCommandPriority::Interactive;
 		return ExecuteSynchronousCommand(*Command, InOperation->GetInProgressString());
 	}
+	else if(InPriority != EPlasticCommandPriority::Interactive)
+	{
+		// hold the request in the scheduler, dispatched from Tick() by order of priority (merged with the other ones of the same burst)
+		Command->bAutoDelete = true;
+		Command->Priority = InPriority;
+		Scheduler.Enqueue(Command);
+		return ECommandResult::Succeeded;
+	}
 	else
 	{
 		Command->bAutoDelete = true;
@@ -203,13 +550,158 @@ ECommandResult::Type FPlasticSourceControlProvider::Execute( const TSharedRef<IS
 	}
 }
 
+void FPlasticSourceControlProvider::DispatchScheduledCommands()
+{
+	// keep the refreshes in the scheduler until the availability of Plastic is known
+	if(bConnecting)
+	{
+		return;
+	}
+
+	// Count the commands held by the scheduler already running (interactive ones are never held, and not counted)
+	int32 NbRunningCommands = 0;
+	for(const FPlasticSourceControlCommand* Command : CommandQueue)
+	{
+		if((Command->Priority != EPlasticCommandPriority::Interactive) && !Command->bExecuteProcessed)
+		{
+			NbRunningCommands++;
+		}
+	}
+
+	// Then dispatch the most urgent ones, leaving at least one 'cm shell' for the interactive commands
+	while(NbRunningCommands < MaxScheduledCommands)
+	{
+		FPlasticSourceControlCommand* Command = Scheduler.Dequeue();
+		if(Command == nullptr)
+		{
+			break;
+		}
+		if(IssueCommand(*Command) == ECommandResult::Succeeded)
+		{
+			NbRunningCommands++;
+		}
+		else
+		{
+			Command->OperationCompleteDelegate.ExecuteIfBound(Command->Operation, ECommandResult::Failed);
+			for(const auto& Follower : Command->Followers)
+			{
+				Follower.Value.ExecuteIfBound(Follower.Key, ECommandResult::Failed);
+			}
+			delete Command;
+		}
+	}
+}
+
+bool FPlasticSourceControlProvider::IsReadOnlyOperation(const FSourceControlOperationRef& InOperation)
+{
+	return (InOperation->GetName() == "UpdateStatus") || (InOperation->GetName() == "PrefetchStatus") || (InOperation->GetName() == "Connect");
+}
+
+FPlasticSourceControlCommand* FPlasticSourceControlProvider::FindIdenticalCommandInFlight(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles) const
+{
+	if(!FPlasticSourceControlScheduler::IsMergeableOperation(InOperation))
+	{
+		return nullptr;
+	}
+
+	TArray<FString> SortedFiles;
+	for(FPlasticSourceControlCommand* Command : CommandQueue)
+	{
+		// only the commands still to complete: a processed one may have got its results before this request
+		if(!Command->bExecuteProcessed && !Command->IsCanceled() && (Command->Files.Num() == InFiles.Num()) && FPlasticSourceControlScheduler::AreIdenticalOperations(Command->Operation, InOperation))
+		{
+			if(SortedFiles.Num() == 0)
+			{
+				SortedFiles = InFiles;
+				SortedFiles.Sort();
+			}
+			TArray<FString> CommandSortedFiles = Command->Files;
+			CommandSortedFiles.Sort();
+			if(CommandSortedFiles == SortedFiles)
+			{
+				return Command;
+			}
+		}
+	}
+	return nullptr;
+}
+
 bool FPlasticSourceControlProvider::CanCancelOperation( const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation ) const
 {
+	if(Scheduler.Find(InOperation) != nullptr)
+	{
+		return true;
+	}
+
+	for(int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
+	{
+		const FPlasticSourceControlCommand& Command = *CommandQueue[CommandIndex];
+		if(Command.Operation == InOperation)
+		{
+			return true;
+		}
+		for(const auto& Follower : Command.Followers)
+		{
+			if(Follower.Key == InOperation)
+			{
+				return true;
+			}
+		}
+	}
+
+	// operation was not in progress!
 	return false;
 }
 
 void FPlasticSourceControlProvider::CancelOperation( const TSharedRef<ISourceControlOperation, ESPMode::ThreadSafe>& InOperation )
 {
+	FPlasticSourceControlCommand* ScheduledCommand = Scheduler.Find(InOperation);
+	if(ScheduledCommand != nullptr)
+	{
+		if(ScheduledCommand->Operation == InOperation)
+		{
+			// not dispatched yet: simply drop it, along with the requests merged into it
+			Scheduler.Remove(ScheduledCommand);
+			ScheduledCommand->OperationCompleteDelegate.ExecuteIfBound(InOperation, ECommandResult::Cancelled);
+			for(const auto& Follower : ScheduledCommand->Followers)
+			{
+				Follower.Value.ExecuteIfBound(Follower.Key, ECommandResult::Cancelled);
+			}
+			delete ScheduledCommand;
+		}
+		else
+		{
+			// only detach the request merged into it
+			const int32 FollowerIndex = ScheduledCommand->Followers.IndexOfByPredicate([&InOperation](const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Follower) { return Follower.Key == InOperation; });
+			const FSourceControlOperationComplete OperationCompleteDelegate = ScheduledCommand->Followers[FollowerIndex].Value;
+			ScheduledCommand->Followers.RemoveAt(FollowerIndex);
+			OperationCompleteDelegate.ExecuteIfBound(InOperation, ECommandResult::Cancelled);
+		}
+		return;
+	}
+
+	for(int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
+	{
+		FPlasticSourceControlCommand& Command = *CommandQueue[CommandIndex];
+		if(Command.Operation == InOperation)
+		{
+			// the 'cm shell' running it (if already started) is killed and then restarted, without stalling the rest of the pool
+			// (along with the identical requests attached to it)
+			Command.Cancel();
+			return;
+		}
+		for(int32 FollowerIndex = 0; FollowerIndex < Command.Followers.Num(); ++FollowerIndex)
+		{
+			if(Command.Followers[FollowerIndex].Key == InOperation)
+			{
+				// only detach the request: the command still runs for the others
+				const FSourceControlOperationComplete OperationCompleteDelegate = Command.Followers[FollowerIndex].Value;
+				Command.Followers.RemoveAt(FollowerIndex);
+				OperationCompleteDelegate.ExecuteIfBound(InOperation, ECommandResult::Cancelled);
+				return;
+			}
+		}
+	}
 }
 
 bool FPlasticSourceControlProvider::UsesLocalReadOnlyState() const
@@ -253,9 +745,104 @@ void FPlasticSourceControlProvider::OutputCommandMessages(const FPlasticSourceCo
 	}
 }
 
+void FPlasticSourceControlProvider::RefreshDirtyFiles()
+{
+	const double Now = FPlatformTime::Seconds();
+	if(!WorkspaceWatcher.IsWatching() || !bServerAvailable || (Now < NextDirtyRefreshTimestamp))
+	{
+		return;
+	}
+	NextDirtyRefreshTimestamp = Now + PlasticWorkspaceWatcherConstants::DirtyRefreshPeriod;
+
+	TArray<FString> DirtyPaths;
+	WorkspaceWatcher.ConsumeDirtyPaths(DirtyPaths);
+
+	// only the files already in cache: the others are queried when the Editor first asks for them
+	TSet<FString> Files;
+	for(const FString& Path : DirtyPaths)
+	{
+		if(StateCache.Contains(Path))
+		{
+			Files.Add(Path);
+		}
+		else if(!FPaths::FileExists(Path))
+		{
+			// a directory, or a file deleted (or renamed) along with its directory
+			for(const auto& State : GetCachedStatesUnder(Path))
+			{
+				Files.Add(State->LocalFilename);
+			}
+		}
+	}
+
+	if(Files.Num() > 0)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Workspace watcher: refresh %d files changed on disk"), Files.Num());
+		// never attached to an identical command in flight, that may have been dispatched before these changes
+		ExecuteWithPriority(ISourceControlOperation::Create<FUpdateStatus>(), Files.Array(), EConcurrency::Asynchronous, FSourceControlOperationComplete(), EPlasticCommandPriority::ForegroundRefresh, false);
+	}
+}
+
 void FPlasticSourceControlProvider::Tick()
 {	
 	bool bStatesUpdated = false;
+
+	// apply the results of the background initialization once ready
+	if(bConnecting && AvailabilityFuture.IsReady())
+	{
+		ApplyPlasticAvailability(AvailabilityFuture.Get());
+		ReconcileStateCacheSnapshot();
+		bStatesUpdated = true;
+	}
+
+	// refresh in background, in one batch per tick, the states taken from the snapshot, instead of querying them in the foreground
+	if(!bConnecting && bPlasticAvailable && (SnapshotFilesToReconcile.Num() > 0))
+	{
+		const TArray<FString> Files = MoveTemp(SnapshotFilesToReconcile);
+		SnapshotFilesToReconcile.Empty();
+		ExecuteWithPriority(ISourceControlOperation::Create<FUpdateStatus>(), Files, EConcurrency::Asynchronous, FSourceControlOperationComplete(), EPlasticCommandPriority::Background);
+	}
+
+	// once connected, the availability of the server follows the heartbeat of the connection health monitor (lost, and then back)
+	if(bConnectSucceeded && PlasticSourceControlUtils::HasConnectionStatus())
+	{
+		const bool bReachable = PlasticSourceControlUtils::IsConnectionAlive();
+		if(bServerAvailable != bReachable)
+		{
+			bServerAvailable = bReachable;
+			bStatesUpdated = true;
+		}
+	}
+
+	RefreshDirtyFiles();
+
+	// complete the status requests answered by the cache (out of their call to Execute(), like any asynchronous request)
+	if(TrustedRequests.Num() > 0)
+	{
+		const TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>> Requests = MoveTemp(TrustedRequests);
+		TrustedRequests.Empty();
+		for(const auto& Request : Requests)
+		{
+			Request.Value.ExecuteIfBound(Request.Key, ECommandResult::Succeeded);
+		}
+	}
+
+	DispatchScheduledCommands();
+
+	// changes of the metadata of the workspace made by cm on behalf of our own commands writing to it do not invalidate the cache,
+	// contrary to the ones made by another Plastic client meanwhile, that the refreshes (only reading the workspace) must not hide;
+	// the changes older than the commands in flight do not matter anymore to trust their results
+	uint64 OldestDispatchGeneration = WorkspaceWatcher.GetGeneration();
+	for(const FPlasticSourceControlCommand* Command : CommandQueue)
+	{
+		if(!IsReadOnlyOperation(Command->Operation))
+		{
+			WorkspaceWatcher.NotifyOwnActivity();
+		}
+		OldestDispatchGeneration = FMath::Min(OldestDispatchGeneration, Command->WatcherGeneration);
+	}
+	WorkspaceWatcher.ForgetChangesBefore(OldestDispatchGeneration);
+
 	for(int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
 	{
 		FPlasticSourceControlCommand& Command = *CommandQueue[CommandIndex];
@@ -268,6 +855,29 @@ void FPlasticSourceControlProvider::Tick()
 			if (Command.Operation->GetName() == "Connect")
 			{
 				bServerAvailable = Command.bCommandSuccessful;
+				bConnectSucceeded |= Command.bCommandSuccessful;
+				if(bServerAvailable)
+				{
+					// fill the cache with the status of the whole workspace in background
+					StartStatusPrefetch();
+					// then only refresh the files changed on disk
+					WorkspaceWatcher.Start(PathToWorkspaceRoot);
+				}
+			}
+			else if ((Command.Operation->GetName() == "UpdateStatus") && Command.bCommandSuccessful && !Command.IsCanceled())
+			{
+				// states read from cm, to be trusted as long as their files do not change on disk
+				WorkspaceWatcher.Trust(Command.Files, Command.WatcherGeneration);
+			}
+			else if ((Command.Operation->GetName() == "PrefetchStatus") && !Command.IsCanceled())
+			{
+				// idem for the files of the workspace whose state has been read, even if some of them could not be
+				WorkspaceWatcher.Trust(StaticCastSharedRef<FPlasticPrefetchStatus>(Command.Operation)->Files, Command.WatcherGeneration);
+			}
+			else if ((Command.Operation->GetName() == "Sync") && Command.bCommandSuccessful)
+			{
+				// the workspace changeset has changed
+				WorkspaceWatcher.Invalidate();
 			}
 			else if (Command.bConnectionDropped)
 			{
@@ -281,8 +891,12 @@ void FPlasticSourceControlProvider::Tick()
 			OutputCommandMessages(Command);
 
 			// run the completion delegate callback if we have one bound
-			ECommandResult::Type Result = Command.bCommandSuccessful ? ECommandResult::Succeeded : ECommandResult::Failed;
+			ECommandResult::Type Result = Command.IsCanceled() ? ECommandResult::Cancelled : (Command.bCommandSuccessful ? ECommandResult::Succeeded : ECommandResult::Failed);
 			Command.OperationCompleteDelegate.ExecuteIfBound(Command.Operation, Result);
+			for(const auto& Follower : Command.Followers)
+			{
+				Follower.Value.ExecuteIfBound(Follower.Key, Result);
+			}
 
 			// commands that are left in the array during a tick need to be deleted
 			if(Command.bAutoDelete)
@@ -326,9 +940,17 @@ ECommandResult::Type FPlasticSourceControlProvider::ExecuteSynchronousCommand(FP
 
 	UE_LOG(LogSourceControl, Log, TEXT("ExecuteSynchronousCommand: %s"), *InCommand.Operation->GetName().ToString());
 
-	// Display the progress dialog if a string was provided
+	struct Local
 	{
-		FScopedSourceControlProgress Progress(Task);
+		static void CancelCommand(FPlasticSourceControlCommand* InControlCommand)
+		{
+			InControlCommand->Cancel();
+		}
+	};
+
+	// Display the progress dialog if a string was provided, with a Cancel button
+	{
+		FScopedSourceControlProgress Progress(Task, FSimpleDelegate::CreateStatic(&Local::CancelCommand, &InCommand));
 
 		// Issue the command asynchronously...
 		IssueCommand( InCommand );
@@ -348,7 +970,11 @@ ECommandResult::Type FPlasticSourceControlProvider::ExecuteSynchronousCommand(FP
 		// always do one more Tick() to make sure the command queue is cleaned up.
 		Tick();
 
-		if(InCommand.bCommandSuccessful)
+		if(InCommand.IsCanceled())
+		{
+			Result = ECommandResult::Cancelled;
+		}
+		else if(InCommand.bCommandSuccessful)
 		{
 			Result = ECommandResult::Succeeded;
 		}
@@ -377,9 +1003,19 @@ ECommandResult::Type FPlasticSourceControlProvider::IssueCommand(FPlasticSourceC
 
 	if(GThreadPool != nullptr)
 	{
-		// Queue this to our worker thread(s) for resolving
-		GThreadPool->AddQueuedWork(&InCommand);
+		// only the changes of the workspace notified from now on can make its results obsolete
+		InCommand.WatcherGeneration = WorkspaceWatcher.GetGeneration();
 		CommandQueue.Add(&InCommand);
+
+		if(bConnecting)
+		{
+			// hold it until the background initialization is applied by Tick(), instead of parking a worker of the thread pool meanwhile
+			HeldCommands.Add(&InCommand);
+		}
+		else
+		{
+			DispatchCommand(InCommand);
+		}
 		return ECommandResult::Succeeded;
 	}
 	else
@@ -387,4 +1023,19 @@ ECommandResult::Type FPlasticSourceControlProvider::IssueCommand(FPlasticSourceC
 		return ECommandResult::Failed;
 	}
 }
+
+void FPlasticSourceControlProvider::DispatchCommand(FPlasticSourceControlCommand& InCommand)
+{
+	if(InCommand.Priority == EPlasticCommandPriority::Interactive)
+	{
+		// background commands yield to it between their chunks, until it completes
+		PlasticSourceControlUtils::BeginInteractiveCommand();
+	}
+
+	// only the changes of the workspace notified from now on can make its results obsolete
+	InCommand.WatcherGeneration = WorkspaceWatcher.GetGeneration();
+
+	// Queue this to our worker thread(s) for resolving
+	GThreadPool->AddQueuedWork(&InCommand);
+}
 #undef LOCTEXT_NAMESPACE
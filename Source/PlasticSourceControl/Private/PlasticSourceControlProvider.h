@@ -5,9 +5,46 @@
 #include "ISourceControlProvider.h"
 #include "IPlasticSourceControlWorker.h"
 #include "PlasticSourceControlState.h"
+#include "PlasticSourceControlCacheSnapshot.h"
+#include "PlasticSourceControlScheduler.h"
+#include "PlasticSourceControlWorkspaceWatcher.h"
+#include "Async.h"
 
 DECLARE_DELEGATE_RetVal(FPlasticSourceControlWorkerRef, FGetPlasticSourceControlWorker)
 
+/**
+ * Results of the probe of the Plastic binary and of the workspace, run in background at initialization
+ */
+struct FPlasticAvailability
+{
+	FPlasticAvailability()
+		: bPlasticAvailable(false)
+		, Changeset(-1)
+	{
+	}
+
+	/** Is Plastic binary found and working. */
+	bool bPlasticAvailable;
+
+	/** Changeset of the workspace, to check the cache snapshot against (-1 if unknown) */
+	int32 Changeset;
+
+	/** Plastic current user */
+	FString UserName;
+
+	/** Plastic current workspace */
+	FString WorkspaceName;
+
+	/** Plastic current repository */
+	FString RepositoryName;
+
+	/** Plastic current server URL */
+	FString ServerUrl;
+
+	/** Name of the current branch */
+	FString BranchName;
+};
+
 class FPlasticSourceControlProvider : public ISourceControlProvider
 {
 public:
@@ -16,6 +53,14 @@ public:
 		: bPlasticAvailable(false)
 		, bWorkspaceFound(false)
 		, bServerAvailable(false)
+		, bConnectSucceeded(false)
+		, bConnecting(false)
+		, WorkspaceChangeset(-1)
+		, bSnapshotStale(false)
+		, MaxScheduledCommands(1)
+		, bPrefetchStarted(false)
+		, PrefetchGeneration(0)
+		, NextDirtyRefreshTimestamp(0.0)
 	{
 	}
 
@@ -46,6 +91,18 @@ public:
 	 */
 	void CheckPlasticAvailability(bool bForceConnection = true);
 
+	/**
+	 * Check the availability of the binary and of the workspace in background, so that the Editor start-up is not gated on cm.
+	 * Results are applied by Tick() once ready, then the commands held meanwhile are dispatched to the thread pool.
+	 */
+	void CheckPlasticAvailabilityAsync();
+
+	/** Is the background check of the availability of Plastic still in progress */
+	inline bool IsConnecting() const
+	{
+		return bConnecting;
+	}
+
 	/** Is Plastic workspace found. */
 	inline bool IsWorkspaceFound() const
 	{
@@ -100,6 +157,9 @@ public:
 	/** Remove a named file from the state cache */
 	bool RemoveFileFromCache(const FString& Filename);
 
+	/** Get the states in cache of all the files under a directory (leaving aside the states of the snapshot not looked up yet) */
+	TArray<TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe>> GetCachedStatesUnder(const FString& InDirectory) const;
+
 private:
 
 	/** Is Plastic binary found and working. */
@@ -111,6 +171,60 @@ private:
 	/** Indicates if source control integration is available or not. */
 	bool bServerAvailable;
 
+	/** Has a "Connect" operation succeeded in this session, the availability of the server then following the connection health monitor. */
+	bool bConnectSucceeded;
+
+	/** Is the availability of Plastic being checked in background. */
+	bool bConnecting;
+
+	/** Results of the background check of the availability of Plastic */
+	TFuture<FPlasticAvailability> AvailabilityFuture;
+
+	/** Wait for the end of the background check of the availability of Plastic (if any) and apply its results */
+	void WaitForPlasticAvailability();
+
+	/** Apply the results of the check of the availability of Plastic */
+	void ApplyPlasticAvailability(const FPlasticAvailability& InAvailability);
+
+	/** Open the snapshot of the state cache saved at the end of the previous session, to show the right states right away */
+	void LoadStateCacheSnapshot();
+
+	/** Save the state cache to its snapshot file, to be loaded at the next start-up */
+	void SaveStateCacheSnapshot();
+
+	/** Check the snapshot against the workspace changeset, once known, and reconcile in background the states looked up in it */
+	void ReconcileStateCacheSnapshot();
+
+	/** Start the background prefetch of the status of the whole workspace (once per session, after the first successful "Connect") */
+	void StartStatusPrefetch();
+
+	/** Completion of the prefetch, ignored if it has been stopped since; started again on the next "Connect" only if the connection has been lost */
+	void OnStatusPrefetchComplete(const FSourceControlOperationRef& InOperation, ECommandResult::Type InResult, uint32 InGeneration);
+
+	/** Stop the prefetch, cancelling it if still in flight */
+	void StopStatusPrefetch();
+
+	/** Refresh in background the cached states of the files changed on disk, as reported by the workspace watcher */
+	void RefreshDirtyFiles();
+
+	/**
+	 * Find a command already in flight (queued or running) for an identical read-only request - same operation, same files -
+	 * so that a new request can attach to it instead of running the same cm commands again (single-flight)
+	 */
+	class FPlasticSourceControlCommand* FindIdenticalCommandInFlight(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles) const;
+
+	/** Does the operation only read the workspace, without ever writing to it nor to its metadata */
+	static bool IsReadOnlyOperation(const FSourceControlOperationRef& InOperation);
+
+	/**
+	 * Execute an operation with the given priority class (see Execute())
+	 * @param	bInJoinInFlight		Can an asynchronous request be attached to an identical command in flight (see FindIdenticalCommandInFlight())
+	 */
+	ECommandResult::Type ExecuteWithPriority(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles, EConcurrency::Type InConcurrency, const FSourceControlOperationComplete& InOperationCompleteDelegate, EPlasticCommandPriority::Type InPriority, bool bInJoinInFlight = true);
+
+	/** Dispatch to the thread pool the most urgent commands held by the scheduler, as long as there are 'cm shell' available for them */
+	void DispatchScheduledCommands();
+
 	/** Helper function for Execute() */
 	TSharedPtr<class IPlasticSourceControlWorker, ESPMode::ThreadSafe> CreateWorker(const FName& InOperationName) const;
 
@@ -118,6 +232,8 @@ private:
 	ECommandResult::Type ExecuteSynchronousCommand(class FPlasticSourceControlCommand& InCommand, const FText& Task);
 	/** Issue a command asynchronously if possible. */
 	ECommandResult::Type IssueCommand(class FPlasticSourceControlCommand& InCommand);
+	/** Queue a command issued to the worker thread(s) of the thread pool. */
+	void DispatchCommand(class FPlasticSourceControlCommand& InCommand);
 
 	/** Output any messages this command holds */
 	void OutputCommandMessages(const class FPlasticSourceControlCommand& InCommand) const;
@@ -140,6 +256,27 @@ private:
 	/** Name of the current branch */
 	FString BranchName;
 
+	/** Changeset of the workspace, as reported by the initial status (-1 if unknown) */
+	int32 WorkspaceChangeset;
+
+	/** Snapshot of the state cache saved at the end of the previous session, looked up in place on cache misses */
+	FPlasticSourceControlCacheSnapshot Snapshot;
+
+	/** Was the snapshot saved at another changeset than the current one of the workspace (revisions then being unreliable) */
+	bool bSnapshotStale;
+
+	/** Files whose state has been taken from the snapshot, waiting to be reconciled in background */
+	TArray<FString> SnapshotFilesToReconcile;
+
+	/** Has the prefetch of the status of the whole workspace been started in this session */
+	bool bPrefetchStarted;
+
+	/** The prefetch operation currently queued or running, if any */
+	TSharedPtr<class ISourceControlOperation, ESPMode::ThreadSafe> PrefetchOperation;
+
+	/** Incremented each time the prefetch is stopped, so that the completion of a prefetch still in flight is ignored */
+	uint32 PrefetchGeneration;
+
 	/** State cache */
 	TMap<FString, TSharedRef<class FPlasticSourceControlState, ESPMode::ThreadSafe> > StateCache;
 
@@ -149,6 +286,24 @@ private:
 	/** Queue for commands given by the main thread */
 	TArray < FPlasticSourceControlCommand* > CommandQueue;
 
+	/** Commands of the queue issued during the background initialization, dispatched to the thread pool once its results are applied */
+	TArray < FPlasticSourceControlCommand* > HeldCommands;
+
+	/** Scheduler holding the asynchronous commands nobody is waiting on, until they get dispatched by order of priority */
+	FPlasticSourceControlScheduler Scheduler;
+
+	/** Watcher of the files of the workspace, telling which cached states can be trusted without querying cm again */
+	FPlasticSourceControlWorkspaceWatcher WorkspaceWatcher;
+
+	/** Next time the files changed on disk get refreshed */
+	double NextDirtyRefreshTimestamp;
+
+	/** Status requests entirely answered by trusted states of the cache, to be completed on the next tick */
+	TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>> TrustedRequests;
+
+	/** Maximum number of commands of the scheduler running concurrently (one less than the 'cm shell' of the pool) */
+	int32 MaxScheduledCommands;
+
 	/** For notifying when the source control states in the cache have changed */
 	FSourceControlStateChanged OnSourceControlStateChanged;
 };
@@ -0,0 +1,153 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlScheduler.h"
+#include "PlasticSourceControlOperations.h"
+
+namespace PlasticSchedulerConstants
+{
+	/** Time spent waiting for a command to get promoted by one priority class, in seconds */
+	static const double AgingPeriod = 2.0;
+
+	/** Maximum number of files of an UpdateStatus command resulting from the merge of many requests, to keep its latency bounded */
+	static const int32 MaxMergedFiles = 2000;
+}
+
+FPlasticSourceControlScheduler::~FPlasticSourceControlScheduler()
+{
+	Empty();
+}
+
+bool FPlasticSourceControlScheduler::IsMergeableOperation(const FSourceControlOperationRef& InOperation)
+{
+	return (InOperation->GetName() == "UpdateStatus");
+}
+
+bool FPlasticSourceControlScheduler::AreIdenticalOperations(const FSourceControlOperationRef& InOperationA, const FSourceControlOperationRef& InOperationB)
+{
+	if(InOperationA->GetName() != InOperationB->GetName())
+	{
+		return false;
+	}
+	if(InOperationA->GetName() == "UpdateStatus")
+	{
+		const FUpdateStatus& UpdateStatusA = static_cast<const FUpdateStatus&>(InOperationA.Get());
+		const FUpdateStatus& UpdateStatusB = static_cast<const FUpdateStatus&>(InOperationB.Get());
+		return (UpdateStatusA.ShouldUpdateHistory() == UpdateStatusB.ShouldUpdateHistory())
+			&& (UpdateStatusA.ShouldGetOpenedOnly() == UpdateStatusB.ShouldGetOpenedOnly())
+			&& (UpdateStatusA.ShouldUpdateModifiedState() == UpdateStatusB.ShouldUpdateModifiedState());
+	}
+	return false;
+}
+
+void FPlasticSourceControlScheduler::Enqueue(FPlasticSourceControlCommand* InCommand)
+{
+	InCommand->QueuedTimestamp = FPlatformTime::Seconds();
+
+	if(IsMergeableOperation(InCommand->Operation))
+	{
+		for(FPendingCommand& PendingCommand : PendingCommands)
+		{
+			// a request without any file is a status of the whole project, that cannot be merged with a request for some files
+			if((PendingCommand.Command->Priority == InCommand->Priority) && AreIdenticalOperations(PendingCommand.Command->Operation, InCommand->Operation)
+				&& ((PendingCommand.Files.Num() == 0) == (InCommand->Files.Num() == 0))
+				&& (PendingCommand.Files.Num() + InCommand->Files.Num() <= PlasticSchedulerConstants::MaxMergedFiles))
+			{
+				// the pending command then notifies the delegate of the request, with its own operation
+				PendingCommand.Files.Append(InCommand->Files);
+				PendingCommand.Command->Followers.Add(TPairInitializer<FSourceControlOperationRef, FSourceControlOperationComplete>(InCommand->Operation, InCommand->OperationCompleteDelegate));
+				PendingCommand.Command->Followers.Append(InCommand->Followers);
+				delete InCommand;
+				return;
+			}
+		}
+	}
+
+	FPendingCommand PendingCommand;
+	PendingCommand.Command = InCommand;
+	PendingCommand.Files.Append(InCommand->Files);
+	PendingCommands.Add(PendingCommand);
+}
+
+FPlasticSourceControlCommand* FPlasticSourceControlScheduler::Dequeue()
+{
+	const double Now = FPlatformTime::Seconds();
+	int32 BestIndex = INDEX_NONE;
+	int32 BestRank = MAX_int32;
+	for(int32 Index = 0; Index < PendingCommands.Num(); Index++)
+	{
+		// each aging period spent waiting promotes the command by one class, up to the interactive class (then served in order of arrival)
+		const FPlasticSourceControlCommand* Command = PendingCommands[Index].Command;
+		const int32 Promotion = FMath::FloorToInt((Now - Command->QueuedTimestamp) / PlasticSchedulerConstants::AgingPeriod);
+		const int32 Rank = FMath::Max(static_cast<int32>(EPlasticCommandPriority::Interactive), static_cast<int32>(Command->Priority) - Promotion);
+		if(Rank < BestRank)
+		{
+			BestRank = Rank;
+			BestIndex = Index;
+		}
+	}
+
+	if(BestIndex == INDEX_NONE)
+	{
+		return nullptr;
+	}
+
+	FPendingCommand PendingCommand = PendingCommands[BestIndex];
+	PendingCommands.RemoveAt(BestIndex);
+	if(PendingCommand.Command->Followers.Num() > 0)
+	{
+		PendingCommand.Command->Files = PendingCommand.Files.Array();
+		UE_LOG(LogSourceControl, Log, TEXT("Scheduler: %d requests merged into %s (of %d files)"), PendingCommand.Command->Followers.Num() + 1, *PendingCommand.Command->Operation->GetName().ToString(), PendingCommand.Command->Files.Num());
+	}
+	return PendingCommand.Command;
+}
+
+FPlasticSourceControlCommand* FPlasticSourceControlScheduler::Find(const FSourceControlOperationRef& InOperation) const
+{
+	for(const FPendingCommand& PendingCommand : PendingCommands)
+	{
+		if(PendingCommand.Command->Operation == InOperation)
+		{
+			return PendingCommand.Command;
+		}
+		for(const auto& Follower : PendingCommand.Command->Followers)
+		{
+			if(Follower.Key == InOperation)
+			{
+				return PendingCommand.Command;
+			}
+		}
+	}
+	return nullptr;
+}
+
+void FPlasticSourceControlScheduler::Remove(FPlasticSourceControlCommand* InCommand)
+{
+	PendingCommands.RemoveAll([InCommand](const FPendingCommand& PendingCommand) { return PendingCommand.Command == InCommand; });
+}
+
+void FPlasticSourceControlScheduler::CancelAll()
+{
+	// taken out of the scheduler first, the delegates being free to issue new requests
+	const TArray<FPendingCommand> CancelledCommands = MoveTemp(PendingCommands);
+	PendingCommands.Empty();
+	for(const FPendingCommand& PendingCommand : CancelledCommands)
+	{
+		FPlasticSourceControlCommand* Command = PendingCommand.Command;
+		Command->OperationCompleteDelegate.ExecuteIfBound(Command->Operation, ECommandResult::Cancelled);
+		for(const auto& Follower : Command->Followers)
+		{
+			Follower.Value.ExecuteIfBound(Follower.Key, ECommandResult::Cancelled);
+		}
+		delete Command;
+	}
+}
+
+void FPlasticSourceControlScheduler::Empty()
+{
+	for(const FPendingCommand& PendingCommand : PendingCommands)
+	{
+		delete PendingCommand.Command;
+	}
+	PendingCommands.Empty();
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+#include "PlasticSourceControlCommand.h"
+
+/**
+ * Scheduler of the asynchronous commands of the provider that nobody is waiting on (refresh, prefetch),
+ * holding them until the provider dispatches them to the thread pool from its Tick(), the most urgent first.
+ *
+ * - priority classes: foreground refreshes go before background prefetches, interactive commands never being held at all
+ * - aging: a command gets promoted by one class for each period spent waiting, so that background commands are never starved
+ * - merging: a request identical to a pending one of the same class (besides its files) is merged into it, over the union of their files
+ */
+class FPlasticSourceControlScheduler
+{
+public:
+	~FPlasticSourceControlScheduler();
+
+	/** Is the operation only reading the state of files, so that identical requests can share the result of one command */
+	static bool IsMergeableOperation(const FSourceControlOperationRef& InOperation);
+
+	/** Are both operations of the same kind requesting the exact same things (besides their files) */
+	static bool AreIdenticalOperations(const FSourceControlOperationRef& InOperationA, const FSourceControlOperationRef& InOperationB);
+
+	/**
+	 * Hold a command until it gets dispatched, merging it into a pending one if possible (the command being then deleted,
+	 * its operation and delegate becoming followers of the pending one)
+	 */
+	void Enqueue(FPlasticSourceControlCommand* InCommand);
+
+	/** Pop the most urgent pending command, after aging, or nullptr if none */
+	FPlasticSourceControlCommand* Dequeue();
+
+	/** Find the pending command of an operation, be it its own operation or the one of a request merged into it */
+	FPlasticSourceControlCommand* Find(const FSourceControlOperationRef& InOperation) const;
+
+	/** Remove a pending command, without deleting it */
+	void Remove(FPlasticSourceControlCommand* InCommand);
+
+	/** Complete all the pending commands as cancelled (notifying the delegates of their operation and of their followers), and delete them */
+	void CancelAll();
+
+	/** Delete all the pending commands, without notifying anybody */
+	void Empty();
+
+	/** Number of pending commands */
+	inline int32 Num() const
+	{
+		return PendingCommands.Num();
+	}
+
+private:
+	/** A pending command, with the union of the files of the requests merged into it */
+	struct FPendingCommand
+	{
+		FPlasticSourceControlCommand* Command;
+		TSet<FString> Files;
+	};
+
+	/** Pending commands, in the order of their arrival */
+	TArray<FPendingCommand> PendingCommands;
+};
@@ -13,6 +13,12 @@ namespace PlasticSettingsConstants
 /** The section of the ini file we load our settings from */
 static const FString SettingsSection = TEXT("PlasticSourceControl.PlasticSourceControlSettings");
 
+/** Default number of background 'cm shell' processes, so that independent operations can run in parallel */
+static const int32 DefaultShellPoolSize = 4;
+
+/** Maximum number of background 'cm shell' processes, each one being a full 'cm' process */
+static const int32 MaxShellPoolSize = 16;
+
 }
 
 const FString& FPlasticSourceControlSettings::GetBinaryPath() const
@@ -27,6 +33,18 @@ void FPlasticSourceControlSettings::SetBinaryPath(const FString& InString)
 	BinaryPath = InString;
 }
 
+int32 FPlasticSourceControlSettings::GetShellPoolSize() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return ShellPoolSize;
+}
+
+void FPlasticSourceControlSettings::SetShellPoolSize(const int32 InShellPoolSize)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	ShellPoolSize = FMath::Clamp(InShellPoolSize, 1, PlasticSettingsConstants::MaxShellPoolSize);
+}
+
 // This is called at startup nearly before anything else in our module: BinaryPath will then be used by the provider
 void FPlasticSourceControlSettings::LoadSettings()
 {
@@ -37,6 +55,11 @@ void FPlasticSourceControlSettings::LoadSettings()
 	{
 		BinaryPath = PlasticSourceControlUtils::FindPlasticBinaryPath();
 	}
+	if(!GConfig->GetInt(*PlasticSettingsConstants::SettingsSection, TEXT("ShellPoolSize"), ShellPoolSize, IniFile))
+	{
+		ShellPoolSize = PlasticSettingsConstants::DefaultShellPoolSize;
+	}
+	ShellPoolSize = FMath::Clamp(ShellPoolSize, 1, PlasticSettingsConstants::MaxShellPoolSize);
 }
 
 void FPlasticSourceControlSettings::SaveSettings() const
@@ -50,5 +73,6 @@ void FPlasticSourceControlSettings::SaveSettings() const
 	{
 		const FString& IniFile = SourceControlHelpers::GetSettingsIni();
 		GConfig->SetString(*PlasticSettingsConstants::SettingsSection, TEXT("BinaryPath"), *BinaryPath, IniFile);
+		GConfig->SetInt(*PlasticSettingsConstants::SettingsSection, TEXT("ShellPoolSize"), ShellPoolSize, IniFile);
 	}
 }
\ No newline at end of file
@@ -11,6 +11,12 @@ public:
 	/** Set the Plastic Binary Path */
 	void SetBinaryPath(const FString& InString);
 
+	/** Get the number of background 'cm shell' processes running concurrently */
+	int32 GetShellPoolSize() const;
+
+	/** Set the number of background 'cm shell' processes running concurrently */
+	void SetShellPoolSize(const int32 InShellPoolSize);
+
 	/** Load settings from ini file */
 	void LoadSettings();
 
@@ -23,4 +29,7 @@ private:
 
 	/** Plastic binary path */
 	FString BinaryPath;
+
+	/** Number of background 'cm shell' processes running concurrently */
+	int32 ShellPoolSize;
 };
\ No newline at end of file
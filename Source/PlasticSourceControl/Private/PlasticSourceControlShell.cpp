@@ -0,0 +1,933 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlShell.h"
+
+#if PLATFORM_LINUX
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Needed to SetHandleInformation() on WritePipe for input (opposite of ReadPipe, for output) (idem FInteractiveProcess)
+static FORCEINLINE bool CreatePipeWrite(void*& ReadPipe, void*& WritePipe)
+{
+#if PLATFORM_WINDOWS
+	SECURITY_ATTRIBUTES Attr = { sizeof(SECURITY_ATTRIBUTES), NULL, true };
+
+	if (!::CreatePipe(&ReadPipe, &WritePipe, &Attr, 0))
+	{
+		return false;
+	}
+
+	if (!::SetHandleInformation(WritePipe, HANDLE_FLAG_INHERIT, 0))
+	{
+		return false;
+	}
+
+	return true;
+#else
+	return FPlatformProcess::CreatePipe(ReadPipe, WritePipe);
+#endif // PLATFORM_WINDOWS
+}
+
+/**
+ * Wait for some output to be available on the read end of a pipe, up to the given timeout, without consuming any CPU.
+ * @returns true if some output is available (or if the pipe is broken), false in case of timeout
+ */
+static bool WaitForPipeReadable(void* InReadPipe, const double InTimeout)
+{
+#if PLATFORM_LINUX
+	// Readiness-based wait on the file descriptor of the pipe, woken up as soon as some bytes arrive
+	struct pollfd PollFd;
+	PollFd.fd = static_cast<FPipeHandle*>(InReadPipe)->GetHandle();
+	PollFd.events = POLLIN;
+	PollFd.revents = 0;
+	const int Ret = poll(&PollFd, 1, static_cast<int>(InTimeout * 1000.0));
+	return (Ret != 0); // error (like EINTR) is treated as readable, the caller then reads nothing and waits again
+#elif PLATFORM_WINDOWS
+	// Anonymous pipes cannot be waited on with WaitForSingleObject(): peek at them with an exponential back-off of sleeps
+	const double EndTimestamp = FPlatformTime::Seconds() + InTimeout;
+	float SleepTime = 0.0001f;
+	while (true)
+	{
+		DWORD BytesAvailable = 0;
+		if (!::PeekNamedPipe(InReadPipe, nullptr, 0, nullptr, &BytesAvailable, nullptr) || (BytesAvailable > 0))
+		{
+			return true;
+		}
+		if (FPlatformTime::Seconds() >= EndTimestamp)
+		{
+			return false;
+		}
+		FPlatformProcess::Sleep(SleepTime);
+		SleepTime = FMath::Min(SleepTime * 2.0f, 0.005f);
+	}
+#else
+	// No way to peek at the pipe without consuming its content: only give up the time slice and let the caller read it
+	FPlatformProcess::Sleep(0.001f);
+	return true;
+#endif
+}
+
+/** Decode a slice of raw UTF-8 output, appending it to a string */
+static FORCEINLINE void AppendUTF8(FString& InOutString, const uint8* InBytes, const int32 InLen)
+{
+	if (InLen > 0)
+	{
+		FUTF8ToTCHAR Converter(reinterpret_cast<const ANSICHAR*>(InBytes), InLen);
+		InOutString.AppendChars(Converter.Get(), Converter.Length());
+	}
+}
+
+uint8* FPlasticShellOutputBuffer::GetWriteSpace(const int32 InMinSpace)
+{
+	// Initial size of the buffer, large enough for the output of most commands
+	static const int32 InitialSize = 64 * 1024;
+
+	if (Bytes.Num() - WritePos < InMinSpace)
+	{
+		// First move the unread bytes back to the beginning of the buffer
+		if (ReadPos > 0)
+		{
+			FMemory::Memmove(Bytes.GetData(), Bytes.GetData() + ReadPos, WritePos - ReadPos);
+			WritePos -= ReadPos;
+			ReadPos = 0;
+		}
+		// Then grow the buffer only if it is still too small
+		if (Bytes.Num() - WritePos < InMinSpace)
+		{
+			Bytes.SetNumUninitialized(FMath::Max3(InitialSize, Bytes.Num() * 2, WritePos + InMinSpace));
+		}
+	}
+
+	return Bytes.GetData() + WritePos;
+}
+
+/**
+ * Incremental scanner of the output of a 'cm shell' command, looking for the "CommandResult <code>" line ending it.
+ *
+ * Only the characters received since the previous scan are looked at, remembering where the current line starts
+ * so that the result line is still matched when it is split across successive reads of the pipe.
+ * The result line has to span a whole line, so that a file named "CommandResult" in the output does not end the command.
+ *
+ * The raw UTF-8 bytes are scanned without decoding them, since the bytes of multi-byte characters never match an ASCII end of line.
+ */
+class FPlasticCommandResultScanner
+{
+public:
+	FPlasticCommandResultScanner()
+		: ScannedLen(0)
+		, LineStart(0)
+		, ResultLineStart(INDEX_NONE)
+		, ResultCode(0)
+	{
+	}
+
+	/**
+	 * Scan the characters appended to the output since the previous call.
+	 * @returns true when the result line has been found
+	 */
+	bool Scan(const uint8* InOutput, const int32 InLen)
+	{
+		for (int32 Index = ScannedLen; Index < InLen; Index++)
+		{
+			if (InOutput[Index] == '\n')
+			{
+				if (MatchResultLine(InOutput + LineStart, Index - LineStart))
+				{
+					ResultLineStart = LineStart;
+					ScannedLen = Index + 1;
+					return true;
+				}
+				LineStart = Index + 1;
+			}
+		}
+		ScannedLen = InLen;
+		return false;
+	}
+
+	/** Index of the beginning of the current line in the output, ie. the end of the complete lines already scanned */
+	int32 GetLineStart() const
+	{
+		return LineStart;
+	}
+
+	/** Forget about the beginning of the output, consumed and removed by the caller */
+	void Consume(const int32 InLen)
+	{
+		ScannedLen -= InLen;
+		LineStart -= InLen;
+		if (ResultLineStart != INDEX_NONE)
+		{
+			ResultLineStart -= InLen;
+		}
+	}
+
+	/** Index of the beginning of the result line in the output */
+	int32 GetResultLineStart() const
+	{
+		return ResultLineStart;
+	}
+
+	/** Index just after the end of the result line in the output, where the output of the next command starts */
+	int32 GetResultLineEnd() const
+	{
+		return ScannedLen;
+	}
+
+	/** Result code of the command: 0 in case of success */
+	int32 GetResultCode() const
+	{
+		return ResultCode;
+	}
+
+private:
+	/** Match a whole "CommandResult <code>" line, without its end of line */
+	bool MatchResultLine(const uint8* InLine, int32 InLen)
+	{
+		static const ANSICHAR CommandResult[] = "CommandResult ";
+		static const int32 CommandResultLen = ARRAY_COUNT(CommandResult) - 1;
+
+		const ANSICHAR* Line = reinterpret_cast<const ANSICHAR*>(InLine);
+		if ((InLen > 0) && (Line[InLen - 1] == '\r'))
+		{
+			InLen--; // Windows end of line
+		}
+		if ((InLen <= CommandResultLen) || (FCStringAnsi::Strncmp(Line, CommandResult, CommandResultLen) != 0))
+		{
+			return false;
+		}
+		// followed only by an integer, optionally negative
+		int32 Index = CommandResultLen;
+		if (Line[Index] == '-')
+		{
+			Index++;
+		}
+		if (Index == InLen)
+		{
+			return false;
+		}
+		for (; Index < InLen; Index++)
+		{
+			if ((Line[Index] < '0') || (Line[Index] > '9'))
+			{
+				return false;
+			}
+		}
+		ResultCode = FCStringAnsi::Atoi(Line + CommandResultLen); // stops at the end of line
+		return true;
+	}
+
+	/** Number of characters of the output already scanned */
+	int32 ScannedLen;
+
+	/** Index of the beginning of the current line in the output */
+	int32 LineStart;
+
+	/** Index of the beginning of the result line in the output, once found */
+	int32 ResultLineStart;
+
+	/** Result code of the command, once found */
+	int32 ResultCode;
+};
+
+FPlasticSourceControlShell::FPlasticSourceControlShell(const int32 InIndex, FPlasticSourceControlWatchdog* InWatchdog)
+	: Index(InIndex)
+	, OutputPipeRead(nullptr)
+	, OutputPipeWrite(nullptr)
+	, InputPipeRead(nullptr)
+	, InputPipeWrite(nullptr)
+	, CancelFlag(nullptr)
+	, Watchdog(InWatchdog)
+	, bTimedOut(0)
+	, LastActivity(0.0)
+	, LongestSilence(0.0)
+{
+}
+
+FPlasticSourceControlShell::~FPlasticSourceControlShell()
+{
+	if (ProcessHandle.IsValid())
+	{
+		FPlatformProcess::CloseProc(ProcessHandle);
+	}
+	Cleanup();
+}
+
+void FPlasticSourceControlShell::Cleanup()
+{
+	FPlatformProcess::ClosePipe(InputPipeRead, InputPipeWrite);
+	FPlatformProcess::ClosePipe(OutputPipeRead, OutputPipeWrite);
+	OutputPipeRead = OutputPipeWrite = nullptr;
+	InputPipeRead = InputPipeWrite = nullptr;
+}
+
+// Launch the Plastic SCM background 'cm shell' process in background for optimized successive commands,
+// if possible (and not already running)
+bool FPlasticSourceControlShell::Launch(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory)
+{
+	// only if shell not already running
+	if (!ProcessHandle.IsValid())
+	{
+		PathToPlasticBinary = InPathToPlasticBinary;
+		WorkingDirectory = InWorkingDirectory;
+
+		const FString FullCommand(TEXT("shell"));
+
+		const bool bLaunchDetached = false;				// the new process will NOT have its own window
+		const bool bLaunchHidden = true;				// the new process will be minimized in the task bar
+		const bool bLaunchReallyHidden = bLaunchHidden; // the new process will not have a window or be in the task bar
+
+		verify(FPlatformProcess::CreatePipe(OutputPipeRead, OutputPipeWrite));	// For reading from child process
+		verify(CreatePipeWrite(InputPipeRead, InputPipeWrite));	// For writing to child process
+
+		UE_LOG(LogSourceControl, Log, TEXT("LaunchBackgroundPlasticShell[%d]: '%s %s'"), Index, *PathToPlasticBinary, *FullCommand);
+		ProcessHandle = FPlatformProcess::CreateProc(*PathToPlasticBinary, *FullCommand, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, nullptr, 0, *WorkingDirectory, OutputPipeWrite, InputPipeRead);
+		if (!ProcessHandle.IsValid())
+		{
+			UE_LOG(LogSourceControl, Warning, TEXT("Failed to launch 'cm shell'")); // not a bug, just no Plastic SCM cli found
+			Cleanup();
+		}
+	}
+
+	return ProcessHandle.IsValid();
+}
+
+bool FPlasticSourceControlShell::Restart()
+{
+	if (ProcessHandle.IsValid())
+	{
+		FPlatformProcess::CloseProc(ProcessHandle);
+	}
+	Cleanup();
+	OutputBuffer.Reset();
+	return Launch(PathToPlasticBinary, WorkingDirectory);
+}
+
+bool FPlasticSourceControlShell::IsRunning()
+{
+	return ProcessHandle.IsValid() && FPlatformProcess::IsProcRunning(ProcessHandle);
+}
+
+void FPlasticSourceControlShell::Abort()
+{
+	FPlatformAtomics::InterlockedExchange(&bTimedOut, 1);
+	// Killing the process also unblocks the thread running the command, wherever it is waiting on the pipes
+	FPlatformProcess::TerminateProc(ProcessHandle, true);
+}
+
+FString FPlasticSourceControlShell::BuildCommandLine(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles)
+{
+	// Start with the Plastic command itself ("status", "log", "chekin"...)
+	FString FullCommand = InCommand;
+	// Append to the command all parameters, and then finally the files
+	for (const FString& Parameter : InParameters)
+	{
+		FullCommand += TEXT(" ");
+		FullCommand += Parameter;
+	}
+	for (const FString& File : InFiles)
+	{
+		FullCommand += TEXT(" \"");
+		FullCommand += File;
+		FullCommand += TEXT("\"");
+	}
+	return FullCommand;
+}
+
+bool FPlasticSourceControlShell::RunCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, FString& OutResults, FString& OutErrors)
+{
+	TArray<FPlasticShellCommand> Commands;
+	Commands.Add(FPlasticShellCommand(InCommand, BuildCommandLine(InCommand, InParameters, InFiles)));
+	RunCommands(Commands);
+
+	OutResults = MoveTemp(Commands[0].Results);
+	OutErrors = MoveTemp(Commands[0].Errors);
+	return Commands[0].bResult;
+}
+
+void FPlasticSourceControlShell::RunCommands(TArray<FPlasticShellCommand>& InOutCommands)
+{
+	if (IsCancelled())
+	{
+		// do not even start the commands of an operation already cancelled
+		for (FPlasticShellCommand& Command : InOutCommands)
+		{
+			Command.bResult = false;
+			Command.Errors = Command.Command + TEXT(": operation cancelled");
+		}
+		return;
+	}
+
+	// Send all the commands back to back to the 'cm shell' process, without waiting for the result of the previous ones
+	FString CommandLines;
+	for (const FPlasticShellCommand& Command : InOutCommands)
+	{
+		// @todo: temporary debug logs (before end of line)
+		UE_LOG(LogSourceControl, Log, TEXT("RunCommandInternal[%d]: '%s'"), Index, *Command.CommandLine);
+		CommandLines += Command.CommandLine;
+		CommandLines += TEXT('\n'); // Finalize the command line
+	}
+	OutputBuffer.Reset();
+	FPlatformAtomics::InterlockedExchange(&bTimedOut, 0);
+	if (!FPlatformProcess::WritePipe(InputPipeWrite, CommandLines))
+	{
+		// the 'cm shell' cannot receive anything (it has stopped): fail right away instead of waiting for an output that will never come
+		UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal[%d]: failed to send %d command(s) to 'cm shell'"), Index, InOutCommands.Num());
+		for (FPlasticShellCommand& Command : InOutCommands)
+		{
+			Command.bResult = false;
+			Command.Results.Empty();
+			Command.Errors = Command.Command + TEXT(": failed to send the command to 'cm shell'");
+		}
+		return;
+	}
+
+	// Then split their outputs apart, each one ending with its own result line
+	for (int32 CommandIndex = 0; CommandIndex < InOutCommands.Num(); CommandIndex++)
+	{
+		FPlasticShellCommand& Command = InOutCommands[CommandIndex];
+		Command.Results.Empty();
+		Command.Errors.Empty();
+		if (Command.LineCallback)
+		{
+			TFunctionRef<void(const FString& InLine)> LineCallback(Command.LineCallback);
+			Command.bResult = ReadCommandOutput(Command.Command, Command.Results, &LineCallback);
+		}
+		else
+		{
+			Command.bResult = ReadCommandOutput(Command.Command, Command.Results);
+		}
+
+		// Return output as error if result code is an error
+		if (!Command.bResult)
+		{
+			Command.Errors = MoveTemp(Command.Results);
+
+			// The 'cm shell' has been killed by a cancellation or by the watchdog: the next commands of the batch will never run,
+			// which is the expected outcome of the kill, not a crash of 'cm shell' to be reported for each one of them
+			const bool bCancelled = IsCancelled();
+			if ((bCancelled || HasTimedOut()) && !FPlatformProcess::IsProcRunning(ProcessHandle))
+			{
+				for (int32 NextIndex = CommandIndex + 1; NextIndex < InOutCommands.Num(); NextIndex++)
+				{
+					FPlasticShellCommand& NextCommand = InOutCommands[NextIndex];
+					NextCommand.bResult = false;
+					NextCommand.Results.Empty();
+					NextCommand.Errors = NextCommand.Command + (bCancelled ? TEXT(": operation cancelled") : TEXT(": not run, 'cm shell' aborted"));
+				}
+				break;
+			}
+		}
+	}
+}
+
+bool FPlasticSourceControlShell::RunCommandStreaming(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TFunctionRef<void(const FString& InLine)> InLineCallback, FString& OutErrors)
+{
+	if (IsCancelled())
+	{
+		OutErrors = InCommand + TEXT(": operation cancelled");
+		return false;
+	}
+
+	const FString CommandLine = BuildCommandLine(InCommand, InParameters, InFiles);
+	// @todo: temporary debug logs (before end of line)
+	UE_LOG(LogSourceControl, Log, TEXT("RunCommandInternal[%d]: '%s'"), Index, *CommandLine);
+	OutputBuffer.Reset();
+	FPlatformAtomics::InterlockedExchange(&bTimedOut, 0);
+	if (!FPlatformProcess::WritePipe(InputPipeWrite, CommandLine + TEXT('\n')))
+	{
+		// the 'cm shell' cannot receive anything (it has stopped): fail right away instead of waiting for an output that will never come
+		UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal[%d](%s): failed to send the command to 'cm shell'"), Index, *InCommand);
+		OutErrors = InCommand + TEXT(": failed to send the command to 'cm shell'");
+		return false;
+	}
+
+	FString OutputHead;
+	const bool bResult = ReadCommandOutput(InCommand, OutputHead, &InLineCallback);
+
+	// Return the beginning of the output as error if result code is an error
+	if (!bResult)
+	{
+		OutErrors = MoveTemp(OutputHead);
+	}
+
+	return bResult;
+}
+
+void FPlasticSourceControlShell::StreamLines(const int32 InLen, TFunctionRef<void(const FString& InLine)> InLineCallback, FString& InOutOutputHead)
+{
+	// Maximum number of characters of the streamed output kept to be reported in case of error
+	static const int32 MaxOutputHeadLen = 4096;
+
+	if (InLen > 0)
+	{
+		const uint8* Bytes = OutputBuffer.GetData();
+		int32 LineStart = 0;
+		for (int32 Pos = 0; Pos < InLen; Pos++)
+		{
+			if (Bytes[Pos] == '\n')
+			{
+				int32 LineLen = Pos - LineStart;
+				if ((LineLen > 0) && (Bytes[Pos - 1] == '\r'))
+				{
+					LineLen--; // Windows end of line
+				}
+				// Skip empty lines, like ParseIntoArray() does for the results of RunCommand()
+				if (LineLen > 0)
+				{
+					// Decode only the complete line, so that a multi-byte character is never split across two reads of the pipe
+					StreamedLine.Reset();
+					AppendUTF8(StreamedLine, Bytes + LineStart, LineLen);
+					InLineCallback(StreamedLine);
+
+					if (InOutOutputHead.Len() < MaxOutputHeadLen)
+					{
+						InOutOutputHead += StreamedLine;
+						InOutOutputHead += TEXT('\n');
+					}
+				}
+				LineStart = Pos + 1;
+			}
+		}
+
+		OutputBuffer.Consume(InLen);
+	}
+}
+
+int32 FPlasticSourceControlShell::ReadOutput()
+{
+	int32 BytesRead = 0;
+
+#if PLATFORM_LINUX
+	const int PipeDesc = static_cast<FPipeHandle*>(OutputPipeRead)->GetHandle();
+	int BytesAvailable = 0;
+	if ((ioctl(PipeDesc, FIONREAD, &BytesAvailable) == 0) && (BytesAvailable > 0))
+	{
+		const ssize_t Ret = read(PipeDesc, OutputBuffer.GetWriteSpace(BytesAvailable), BytesAvailable);
+		BytesRead = (Ret > 0) ? static_cast<int32>(Ret) : 0;
+	}
+#elif PLATFORM_WINDOWS
+	DWORD BytesAvailable = 0;
+	if (::PeekNamedPipe(OutputPipeRead, nullptr, 0, nullptr, &BytesAvailable, nullptr) && (BytesAvailable > 0))
+	{
+		DWORD BytesReadFromPipe = 0;
+		if (::ReadFile(OutputPipeRead, OutputBuffer.GetWriteSpace(BytesAvailable), BytesAvailable, &BytesReadFromPipe, nullptr))
+		{
+			BytesRead = static_cast<int32>(BytesReadFromPipe);
+		}
+	}
+#else
+	// No direct access to the pipe: copy the bytes read by the platform layer
+	TArray<uint8> Bytes;
+	if (FPlatformProcess::ReadPipeToArray(OutputPipeRead, Bytes))
+	{
+		BytesRead = Bytes.Num();
+		FMemory::Memcpy(OutputBuffer.GetWriteSpace(BytesRead), Bytes.GetData(), BytesRead);
+	}
+#endif
+
+	OutputBuffer.Commit(BytesRead);
+	return BytesRead;
+}
+
+bool FPlasticSourceControlShell::ReadCommandOutput(const FString& InCommand, FString& OutResults, TFunctionRef<void(const FString& InLine)>* InLineCallback)
+{
+	bool bResult = false;
+
+	// Maximum duration of each blocking wait for output, before checking again for the process and the cancellation
+	const double WaitForOutputSlice = 0.1;
+	const double StartTimestamp = FPlatformTime::Seconds();
+	LastActivity = StartTimestamp;
+	LongestSilence = 0.0;
+
+	// Let the watchdog abort the command if it stays silent for longer than the budget of its type of command
+	if (Watchdog != nullptr)
+	{
+		Watchdog->BeginCommand(this, InCommand);
+	}
+
+	// Search the new output for the line containing the result code, also indicating the end of the command
+	FPlasticCommandResultScanner ResultScanner;
+	auto ScanOutput = [this, &ResultScanner, &OutResults, InLineCallback]() -> bool
+	{
+		const bool bResultFound = ResultScanner.Scan(OutputBuffer.GetData(), OutputBuffer.Num());
+		if (InLineCallback != nullptr)
+		{
+			// Streaming: hand each complete line to the caller as soon as it is received, and drop it from the output
+			const int32 CompleteLen = bResultFound ? ResultScanner.GetResultLineStart() : ResultScanner.GetLineStart();
+			StreamLines(CompleteLen, *InLineCallback, OutResults);
+			ResultScanner.Consume(CompleteLen);
+		}
+		return bResultFound;
+	};
+
+	// Start with the output already received while reading the result of the previous command, if any
+	bool bFound = ScanOutput();
+	bool bCancelled = false;
+	while (!bFound && FPlatformProcess::IsProcRunning(ProcessHandle))
+	{
+		if (IsCancelled())
+		{
+			// 'cm shell' cannot be interrupted: kill it, it is restarted the next time it is leased from the pool
+			UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal[%d](%s): cancelled after '%lf's, killing 'cm shell'"), Index, *InCommand, (FPlatformTime::Seconds() - StartTimestamp));
+			FPlatformProcess::TerminateProc(ProcessHandle, true);
+			bCancelled = true;
+			break;
+		}
+
+		// Block until some output is available, waking up regularly to check that the process is still running
+		int32 BytesRead = 0;
+		if (WaitForPipeReadable(OutputPipeRead, WaitForOutputSlice))
+		{
+			BytesRead = ReadOutput();
+		}
+		if (0 < BytesRead)
+		{
+			// freshen the timestamp while cm is still actively outputting information
+			const double Now = FPlatformTime::Seconds();
+			LongestSilence = FMath::Max(LongestSilence, Now - LastActivity);
+			LastActivity = Now;
+			bFound = ScanOutput();
+		}
+	}
+
+	if (Watchdog != nullptr)
+	{
+		Watchdog->EndCommand(this);
+	}
+
+	if (bCancelled || (!bFound && HasTimedOut()))
+	{
+		// drop any partial output, the process being killed
+		OutputBuffer.Reset();
+	}
+	else if (!bFound)
+	{
+		// Get any output written by the process just before it stopped
+		while (0 < ReadOutput())
+		{
+		}
+		bFound = ScanOutput();
+	}
+
+	if (bFound)
+	{
+		bResult = (0 == ResultScanner.GetResultCode());
+		// remove the CommandResult line from the results, keeping the output of the next commands (if any) pending
+		if (InLineCallback == nullptr)
+		{
+			// decode only now the results of the command, all at once
+			AppendUTF8(OutResults, OutputBuffer.GetData(), ResultScanner.GetResultLineStart());
+		}
+		// else the results have already been streamed, OutResults only containing a copy of their beginning
+		OutputBuffer.Consume(ResultScanner.GetResultLineEnd());
+	}
+	else
+	{
+		AppendUTF8(OutResults, OutputBuffer.GetData(), OutputBuffer.Num());
+		OutputBuffer.Reset();
+	}
+
+	if (bCancelled)
+	{
+		OutResults += InCommand + TEXT(": operation cancelled");
+	}
+	else if (!bFound && HasTimedOut())
+	{
+		// 'cm shell' has been killed by the watchdog. Will restart on next command.
+		UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal[%d](%s) TIMEOUT after '%lf's"), Index, *InCommand, (FPlatformTime::Seconds() - StartTimestamp));
+		OutResults += InCommand + TEXT(": timeout, 'cm shell' aborted");
+	}
+	else if (!InCommand.Equals(TEXT("exit")) && !FPlatformProcess::IsProcRunning(ProcessHandle))
+	{
+		// 'cm shell' normally only terminates in case of 'exit' command. Will restart on next command.
+		UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal[%d](%s): 'cm shell' stopped after '%lf's Out=\n%s"), Index, *InCommand, (FPlatformTime::Seconds() - StartTimestamp), *OutResults);
+	}
+	else
+	{
+		// @todo: temporary debug logs
+		UE_LOG(LogSourceControl, Log, TEXT("RunCommandInternal[%d](%s)=%d in '%lf's Out=\n%s"), Index, *InCommand, bResult, (FPlatformTime::Seconds() - StartTimestamp), *OutResults);
+	}
+
+	return bResult;
+}
+
+void FPlasticSourceControlShell::Exit()
+{
+	if (ProcessHandle.IsValid())
+	{
+		// Tell the 'cm shell' to exit
+		FString Results, Errors;
+		RunCommand(TEXT("exit"), TArray<FString>(), TArray<FString>(), Results, Errors);
+		// And wait up to one seconde for its termination
+		int timeout = 100;
+		while (FPlatformProcess::IsProcRunning(ProcessHandle) && (0 < timeout--))
+		{
+			FPlatformProcess::Sleep(0.01f);
+		}
+		FPlatformProcess::CloseProc(ProcessHandle);
+		Cleanup();
+	}
+}
+
+
+FPlasticSourceControlShellPool::FPlasticSourceControlShellPool()
+	: ShellReleasedEvent(nullptr)
+	, NbWaitingLeases(0)
+	, NbNonInteractiveLeases(0)
+	, StandbyShell(nullptr)
+{
+}
+
+FPlasticSourceControlShellPool::~FPlasticSourceControlShellPool()
+{
+	Terminate();
+}
+
+bool FPlasticSourceControlShellPool::Launch(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory, const int32 InPoolSize)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	// only if the pool is not already running
+	if (Shells.Num() == 0)
+	{
+		if (ShellReleasedEvent == nullptr)
+		{
+			ShellReleasedEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		}
+
+		PathToPlasticBinary = InPathToPlasticBinary;
+		WorkingDirectory = InWorkingDirectory;
+
+		const int32 PoolSize = FMath::Max(1, InPoolSize);
+		for (int32 Index = 0; Index < PoolSize; Index++)
+		{
+			FPlasticSourceControlShell* Shell = new FPlasticSourceControlShell(Index, &Watchdog);
+			if (Shell->Launch(InPathToPlasticBinary, InWorkingDirectory))
+			{
+				Shells.Add(Shell);
+				FreeShells.Add(Shell);
+			}
+			else
+			{
+				// no need to try to launch the others: the Plastic binary is not working
+				delete Shell;
+				break;
+			}
+		}
+		UE_LOG(LogSourceControl, Log, TEXT("LaunchBackgroundPlasticShell: %d/%d 'cm shell' running"), Shells.Num(), PoolSize);
+
+		if (Shells.Num() > 0)
+		{
+			Watchdog.Launch();
+			// One more 'cm shell', kept in standby to replace instantly any shell that crashes or is aborted
+			SpawnStandbyShell(new FPlasticSourceControlShell(PoolSize, &Watchdog));
+		}
+	}
+
+	return (Shells.Num() > 0);
+}
+
+void FPlasticSourceControlShellPool::SpawnStandbyShell(FPlasticSourceControlShell* InShell)
+{
+	TFuture<void> Future = Async<void>(EAsyncExecution::ThreadPool, [this, InShell]()
+	{
+		// Pay the start-up cost of 'cm' in the background, up to its first command
+		bool bReady = InShell->IsLaunched() ? InShell->Restart() : InShell->Launch(PathToPlasticBinary, WorkingDirectory);
+		if (bReady)
+		{
+			FString Results, Errors;
+			bReady = InShell->RunCommand(TEXT("version"), TArray<FString>(), TArray<FString>(), Results, Errors);
+		}
+
+		bool bStandby = false;
+		{
+			FScopeLock ScopeLock(&CriticalSection);
+			if (bReady && (Shells.Num() > 0))
+			{
+				StandbyShell = InShell;
+				bStandby = true;
+			}
+		}
+
+		if (!bStandby)
+		{
+			// The pool has been terminated meanwhile, or 'cm' failed to start
+			UE_LOG(LogSourceControl, Log, TEXT("LaunchBackgroundPlasticShell[%d]: no standby 'cm shell'"), InShell->GetIndex());
+			InShell->Exit();
+			delete InShell;
+		}
+	});
+
+	FScopeLock ScopeLock(&CriticalSection);
+	StandbyFuture = MoveTemp(Future);
+}
+
+void FPlasticSourceControlShellPool::Terminate()
+{
+	TArray<FPlasticSourceControlShell*> ShellsToExit;
+	TFuture<void> Future;
+	{
+		FScopeLock ScopeLock(&CriticalSection);
+		// Shells currently leased are not part of the pool anymore: they will be terminated when released
+		ShellsToExit = MoveTemp(FreeShells);
+		FreeShells.Empty();
+		Shells.Empty();
+		if (StandbyShell != nullptr)
+		{
+			ShellsToExit.Add(StandbyShell);
+			StandbyShell = nullptr;
+		}
+		Future = MoveTemp(StandbyFuture);
+	}
+
+	// Wait (outside of the lock) for the standby shell being spawned in the background, if any: it gives up as soon as it sees the pool is empty
+	if (Future.IsValid())
+	{
+		Future.Wait();
+	}
+
+	for (FPlasticSourceControlShell* Shell : ShellsToExit)
+	{
+		Shell->Exit();
+		delete Shell;
+	}
+
+	// Shells still leased are not tracked anymore by the watchdog
+	Watchdog.Terminate();
+
+	// Wake up the threads waiting for a shell, so that they see the pool is empty, before returning the event to the pool
+	FEvent* Event = nullptr;
+	for (;;)
+	{
+		{
+			FScopeLock ScopeLock(&CriticalSection);
+			if (NbWaitingLeases == 0)
+			{
+				Event = ShellReleasedEvent;
+				ShellReleasedEvent = nullptr;
+				break;
+			}
+			ShellReleasedEvent->Trigger();
+		}
+		FPlatformProcess::Sleep(0.01f);
+	}
+	if (Event != nullptr)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(Event);
+	}
+}
+
+bool FPlasticSourceControlShellPool::IsLaunched() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return (Shells.Num() > 0);
+}
+
+int32 FPlasticSourceControlShellPool::Num() const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return Shells.Num();
+}
+
+FPlasticSourceControlShell* FPlasticSourceControlShellPool::Lease(const bool bInInteractive)
+{
+	FPlasticSourceControlShell* Shell = nullptr;
+
+	while (Shell == nullptr)
+	{
+		{
+			FScopeLock ScopeLock(&CriticalSection);
+			if (Shells.Num() == 0)
+			{
+				break; // pool not launched, or terminated
+			}
+			// the last free shell is reserved to interactive commands
+			const bool bCanLease = bInInteractive || (Shells.Num() <= 1) || (NbNonInteractiveLeases < Shells.Num() - 1);
+			if ((FreeShells.Num() > 0) && bCanLease)
+			{
+				Shell = FreeShells.Pop(false);
+				if (!bInInteractive)
+				{
+					NbNonInteractiveLeases++;
+				}
+			}
+			else
+			{
+				// keeps the event alive while waiting on it
+				NbWaitingLeases++;
+			}
+		}
+		if (Shell == nullptr)
+		{
+			// All shells are busy (or reserved): wait for one to be released
+			ShellReleasedEvent->Wait(100);
+			FScopeLock ScopeLock(&CriticalSection);
+			NbWaitingLeases--;
+		}
+	}
+
+	if (Shell != nullptr)
+	{
+		// Detect previous crash of cm.exe (or abort of 'cm shell')
+		if (!Shell->IsRunning())
+		{
+			// Swap it instantly with the standby shell if it is ready, the stopped one being restarted in background as the next standby
+			FPlasticSourceControlShell* StoppedShell = Shell;
+			{
+				FScopeLock ScopeLock(&CriticalSection);
+				const int32 ShellIndex = Shells.Find(StoppedShell);
+				if ((StandbyShell != nullptr) && (ShellIndex != INDEX_NONE) && StandbyShell->IsRunning())
+				{
+					Shell = StandbyShell;
+					StandbyShell = nullptr;
+					Shells[ShellIndex] = Shell;
+				}
+			}
+
+			if (Shell != StoppedShell)
+			{
+				UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal[%d]: 'cm shell' has stopped. Swapped with standby [%d]"), StoppedShell->GetIndex(), Shell->GetIndex());
+				SpawnStandbyShell(StoppedShell);
+			}
+			else
+			{
+				// No standby ready: restart 'cm shell', outside of the lock so that other commands are not stalled
+				UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal[%d]: 'cm shell' has stopped. Restarting!"), Shell->GetIndex());
+				Shell->Restart();
+			}
+		}
+	}
+
+	return Shell;
+}
+
+void FPlasticSourceControlShellPool::Release(FPlasticSourceControlShell* InShell, const bool bInInteractive)
+{
+	check(InShell != nullptr);
+
+	bool bPartOfPool;
+	{
+		FScopeLock ScopeLock(&CriticalSection);
+		if (!bInInteractive)
+		{
+			NbNonInteractiveLeases--;
+		}
+		bPartOfPool = Shells.Contains(InShell);
+		if (bPartOfPool)
+		{
+			FreeShells.Push(InShell);
+			// under the lock, so that the pool cannot be terminated and its event returned meanwhile
+			ShellReleasedEvent->Trigger();
+		}
+	}
+
+	if (!bPartOfPool)
+	{
+		// The pool has been terminated while this shell was leased
+		InShell->Exit();
+		delete InShell;
+	}
+}
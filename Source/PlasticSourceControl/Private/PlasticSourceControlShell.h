@@ -0,0 +1,402 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+#include "PlasticSourceControlWatchdog.h"
+#include "Async.h"
+
+/**
+ * A command sent to a 'cm shell' process, and its raw output.
+ */
+struct FPlasticShellCommand
+{
+	FPlasticShellCommand(const FString& InCommand, const FString& InCommandLine)
+		: Command(InCommand)
+		, CommandLine(InCommandLine)
+		, bResult(false)
+	{
+	}
+
+	/** The Plastic command - e.g. status, for logs */
+	FString Command;
+
+	/** The full command line, with parameters and files, without end of line */
+	FString CommandLine;
+
+	/** true if the command succeeded and returned no errors */
+	bool bResult;
+
+	/** The results (from StdOut) without the final "CommandResult" line */
+	FString Results;
+
+	/** The results in case of an error */
+	FString Errors;
+
+	/** If bound, called for each non-empty line of the results as soon as it is received (streaming), Results then only keeping their beginning */
+	TFunction<void(const FString& InLine)> LineCallback;
+};
+
+/**
+ * Reusable buffer of the raw bytes read from the output pipe of a 'cm shell', with read and write cursors.
+ *
+ * Works like a ring buffer, except that the unread bytes are moved back to the beginning instead of wrapping around,
+ * so that each line of output stays contiguous in memory, to be scanned and decoded in place.
+ */
+class FPlasticShellOutputBuffer
+{
+public:
+	FPlasticShellOutputBuffer()
+		: ReadPos(0)
+		, WritePos(0)
+	{
+	}
+
+	/** The bytes received but not yet consumed */
+	const uint8* GetData() const
+	{
+		return Bytes.GetData() + ReadPos;
+	}
+
+	/** Number of bytes received but not yet consumed */
+	int32 Num() const
+	{
+		return WritePos - ReadPos;
+	}
+
+	/** Get some free space at the end of the buffer to write at least the given number of bytes, growing it only if needed */
+	uint8* GetWriteSpace(const int32 InMinSpace);
+
+	/** Account for the bytes written to the space returned by GetWriteSpace() */
+	void Commit(const int32 InLen)
+	{
+		WritePos += InLen;
+	}
+
+	/** Consume bytes from the beginning of the buffer, rewinding it when empty */
+	void Consume(const int32 InLen)
+	{
+		ReadPos += InLen;
+		if (ReadPos == WritePos)
+		{
+			Reset();
+		}
+	}
+
+	/** Drop all the bytes of the buffer, keeping its memory */
+	void Reset()
+	{
+		ReadPos = WritePos = 0;
+	}
+
+private:
+	/** Raw bytes, allocated once and then reused from one command to the next */
+	TArray<uint8> Bytes;
+
+	/** Index of the first byte not yet consumed */
+	int32 ReadPos;
+
+	/** Index just after the last byte received */
+	int32 WritePos;
+};
+
+/**
+ * One background 'cm shell' process and its In/Out pipes, to run successive Plastic commands without paying the start-up cost of 'cm' each time.
+ */
+class FPlasticSourceControlShell
+{
+public:
+	FPlasticSourceControlShell(const int32 InIndex, FPlasticSourceControlWatchdog* InWatchdog);
+	~FPlasticSourceControlShell();
+
+	/**
+	 * Launch the 'cm shell' process in background (if not already running)
+	 * @param	InPathToPlasticBinary	The path to the Plastic binary
+	 * @param	InWorkingDirectory		The workspace from where to run the command - usually the Game directory
+	 * @returns true if the process is running
+	 */
+	bool Launch(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory);
+
+	/** Close the handle and pipes of a crashed 'cm shell' and launch a new one */
+	bool Restart();
+
+	/** Tell the 'cm shell' process to exit, wait for its termination, then close its handle and pipes */
+	void Exit();
+
+	/** Is the 'cm shell' process launched (but not necessarily still running) */
+	bool IsLaunched() const
+	{
+		return ProcessHandle.IsValid();
+	}
+
+	/** Is the 'cm shell' process still running */
+	bool IsRunning();
+
+	/** Index of the shell in its pool, for logs */
+	int32 GetIndex() const
+	{
+		return Index;
+	}
+
+	/** Set the cancel flag of the operation leasing the shell: the 'cm shell' is killed if it is set while a command is running */
+	void SetCancelFlag(const volatile int32* InCancelFlag)
+	{
+		CancelFlag = InCancelFlag;
+	}
+
+	/** Get the cancel flag of the operation leasing the shell, if any */
+	const volatile int32* GetCancelFlag() const
+	{
+		return CancelFlag;
+	}
+
+	/** Has the operation leasing the shell been cancelled */
+	bool IsCancelled() const
+	{
+		return (CancelFlag != nullptr) && (*CancelFlag != 0);
+	}
+
+	/** Kill the 'cm shell' process, from the watchdog thread, when its current command has been silent for too long */
+	void Abort();
+
+	/** Has the last command been aborted by the watchdog */
+	bool HasTimedOut() const
+	{
+		return (bTimedOut != 0);
+	}
+
+	/** Timestamp of the last output received from the 'cm shell' */
+	double GetLastActivity() const
+	{
+		return LastActivity;
+	}
+
+	/** Longest silence between two outputs of the current (or last) command, in seconds */
+	double GetLongestSilence() const
+	{
+		return LongestSilence;
+	}
+
+	/**
+	 * Send a command to the 'cm shell' process and wait for the "CommandResult" line telling it has finished.
+	 *
+	 * @param	InCommand			The Plastic command - e.g. commit
+	 * @param	InParameters		The parameters to the Plastic command
+	 * @param	InFiles				The files to be operated on
+	 * @param	OutResults			The results (from StdOut) without the final "CommandResult" line
+	 * @param	OutErrors			The results in case of an error
+	 * @returns true if the command succeeded and returned no errors
+	 */
+	bool RunCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, FString& OutResults, FString& OutErrors);
+
+	/**
+	 * Send a command to the 'cm shell' process, and hand each line of its output to the caller as soon as it is received,
+	 * instead of buffering the whole output.
+	 *
+	 * @param	InCommand			The Plastic command - e.g. status
+	 * @param	InParameters		The parameters to the Plastic command
+	 * @param	InFiles				The files to be operated on
+	 * @param	InLineCallback		Called for each non-empty line of output, without its end of line (the string is reused for the next line)
+	 * @param	OutErrors			The beginning of the output in case of an error
+	 * @returns true if the command succeeded and returned no errors
+	 */
+	bool RunCommandStreaming(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TFunctionRef<void(const FString& InLine)> InLineCallback, FString& OutErrors);
+
+	/**
+	 * Send several commands back to back to the 'cm shell' process (pipelining), without waiting for the result of each one,
+	 * then split their outputs apart by their "CommandResult" lines.
+	 *
+	 * @param	InOutCommands		The commands to run, in order, and their outputs
+	 */
+	void RunCommands(TArray<FPlasticShellCommand>& InOutCommands);
+
+	/** Build the full command line of a Plastic command, with its parameters and then the files between quotes */
+	static FString BuildCommandLine(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles);
+
+private:
+	/**
+	 * Wait for the output of a command, up to its "CommandResult" line, leaving the beginning of the output of the next commands in the output buffer
+	 * @param	InCommand			The Plastic command, for logs
+	 * @param	OutResults			The output of the command without its final "CommandResult" line, or only its beginning when streaming
+	 * @param	InLineCallback		If not null, called for each line of output as soon as it is received (streaming)
+	 * @returns true if the command succeeded and returned no errors
+	 */
+	bool ReadCommandOutput(const FString& InCommand, FString& OutResults, TFunctionRef<void(const FString& InLine)>* InLineCallback = nullptr);
+
+	/** Read all the bytes available on the output pipe, without blocking, directly into the output buffer, returning their number */
+	int32 ReadOutput();
+
+	/** Hand each complete line of the beginning of the output buffer to the caller and consume them, keeping a copy of the beginning of the output for errors */
+	void StreamLines(const int32 InLen, TFunctionRef<void(const FString& InLine)> InLineCallback, FString& InOutOutputHead);
+
+	/** Close the In/Out pipes */
+	void Cleanup();
+
+	/** Index of the shell in its pool */
+	int32 Index;
+
+	/** Path to the Plastic binary and working directory used to launch the process, kept to restart it */
+	FString PathToPlasticBinary;
+	FString WorkingDirectory;
+
+	/** In/Out Pipes for the 'cm shell' persistent process */
+	void* OutputPipeRead;
+	void* OutputPipeWrite;
+	void* InputPipeRead;
+	void* InputPipeWrite;
+	FProcHandle ProcessHandle;
+
+	/** Cancel flag of the operation leasing the shell, if any */
+	const volatile int32* CancelFlag;
+
+	/** Watchdog tracking the commands of the shell, if any */
+	FPlasticSourceControlWatchdog* Watchdog;
+
+	/** Set by the watchdog when it aborts the current command */
+	volatile int32 bTimedOut;
+
+	/** Timestamp of the last output received, read by the watchdog */
+	volatile double LastActivity;
+
+	/** Longest silence between two outputs of the current command, learned by the watchdog */
+	volatile double LongestSilence;
+
+	/** Raw UTF-8 output received from the 'cm shell' and not yet consumed */
+	FPlasticShellOutputBuffer OutputBuffer;
+
+	/** Line of output handed to the caller when streaming, reused from one line to the next */
+	FString StreamedLine;
+};
+
+/**
+ * Pool of background 'cm shell' processes, leased one at a time to the commands running concurrently on the thread pool.
+ */
+class FPlasticSourceControlShellPool
+{
+public:
+	FPlasticSourceControlShellPool();
+	~FPlasticSourceControlShellPool();
+
+	/**
+	 * Launch the pool of 'cm shell' processes (if not already running)
+	 * @param	InPathToPlasticBinary	The path to the Plastic binary
+	 * @param	InWorkingDirectory		The workspace from where to run the commands - usually the Game directory
+	 * @param	InPoolSize				The number of 'cm shell' processes to launch
+	 * @returns true if at least one 'cm shell' is running
+	 */
+	bool Launch(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory, const int32 InPoolSize);
+
+	/** Tell all the 'cm shell' processes to exit, waiting for the ones leased to be returned */
+	void Terminate();
+
+	/** Is there any 'cm shell' in the pool */
+	bool IsLaunched() const;
+
+	/** Number of 'cm shell' in the pool, ie. the maximum number of commands running concurrently */
+	int32 Num() const;
+
+	/**
+	 * Lease a free 'cm shell', waiting for one to be released if they are all busy, and restart it if it has crashed.
+	 * One 'cm shell' is reserved to interactive commands (if the pool has more than one), so that they never wait behind refreshes.
+	 * @param	bInInteractive		Is the lease on behalf of an interactive command, allowed to take the reserved shell
+	 * @returns the shell to run commands on, or nullptr if the pool is not launched
+	 */
+	FPlasticSourceControlShell* Lease(const bool bInInteractive);
+
+	/** Return a leased 'cm shell' to the pool, with the same interactive flag it was leased with */
+	void Release(FPlasticSourceControlShell* InShell, const bool bInInteractive);
+
+private:
+	/** (Re)start a 'cm shell' in the background, and keep it as the standby once it is ready to run commands */
+	void SpawnStandbyShell(FPlasticSourceControlShell* InShell);
+
+	/** Watchdog thread aborting the commands running for too long on the shells of the pool */
+	FPlasticSourceControlWatchdog Watchdog;
+
+	/** Critical section protecting the arrays of shells */
+	mutable FCriticalSection CriticalSection;
+
+	/** All the 'cm shell' of the pool (owned) */
+	TArray<FPlasticSourceControlShell*> Shells;
+
+	/** The 'cm shell' not currently leased */
+	TArray<FPlasticSourceControlShell*> FreeShells;
+
+	/** Event triggered each time a shell is released to the pool (returned to the pool of events on termination) */
+	FEvent* ShellReleasedEvent;
+
+	/** Number of threads waiting on the event for a shell to be released */
+	int32 NbWaitingLeases;
+
+	/** Number of shells currently leased on behalf of non-interactive commands */
+	int32 NbNonInteractiveLeases;
+
+	/** Path to the Plastic binary and working directory of the pool, to launch the standby shell */
+	FString PathToPlasticBinary;
+	FString WorkingDirectory;
+
+	/** Pre-spawned and initialized 'cm shell', swapped in place of a crashed or aborted one (owned, not part of the pool) */
+	FPlasticSourceControlShell* StandbyShell;
+
+	/** Completion of the background spawn of the standby shell */
+	TFuture<void> StandbyFuture;
+};
+
+/**
+ * Lease a 'cm shell' from the pool for the lifetime of this object, on behalf of an operation that can be cancelled.
+ */
+class FScopedPlasticShell
+{
+public:
+	FScopedPlasticShell(FPlasticSourceControlShellPool& InPool, const volatile int32* InCancelFlag, const bool bInInteractive)
+		: Pool(InPool)
+		, Shell(InPool.Lease(bInInteractive))
+		, bInteractive(bInInteractive)
+	{
+		if (Shell != nullptr)
+		{
+			Shell->SetCancelFlag(InCancelFlag);
+		}
+	}
+
+	~FScopedPlasticShell()
+	{
+		if (Shell != nullptr)
+		{
+			Shell->SetCancelFlag(nullptr);
+			Pool.Release(Shell, bInteractive);
+		}
+	}
+
+	bool IsValid() const
+	{
+		return (Shell != nullptr);
+	}
+
+	/** Release the shell and lease another one from the pool (restarted if it has crashed or been aborted) */
+	void Reset()
+	{
+		const volatile int32* CancelFlag = nullptr;
+		if (Shell != nullptr)
+		{
+			CancelFlag = Shell->GetCancelFlag();
+			Shell->SetCancelFlag(nullptr);
+			Pool.Release(Shell, bInteractive);
+		}
+		Shell = Pool.Lease(bInteractive);
+		if (Shell != nullptr)
+		{
+			Shell->SetCancelFlag(CancelFlag);
+		}
+	}
+
+	FPlasticSourceControlShell* operator->() const
+	{
+		return Shell;
+	}
+
+private:
+	FPlasticSourceControlShellPool& Pool;
+	FPlasticSourceControlShell* Shell;
+	/** Is the shell leased on behalf of an interactive command */
+	bool bInteractive;
+};
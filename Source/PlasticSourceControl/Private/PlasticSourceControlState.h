@@ -89,6 +89,9 @@ public:
 	/** Location of the locked file. */
 	FString LockedWhere;
 
+	/** Original filename of a moved/renamed file */
+	FString MovedFrom;
+
 	/** State of the workspace */
 	EWorkspaceState::Type WorkspaceState;
 
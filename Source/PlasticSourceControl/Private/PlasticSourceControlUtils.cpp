@@ -5,6 +5,8 @@
 #include "PlasticSourceControlState.h"
 #include "PlasticSourceControlModule.h"
 #include "PlasticSourceControlCommand.h"
+#include "PlasticSourceControlShell.h"
+#include "PlasticSourceControlConnectionMonitor.h"
 #include "XmlParser.h"
 
 #if PLATFORM_LINUX
@@ -19,6 +21,18 @@ namespace PlasticSourceControlConstants
 #else
 	const TCHAR* pchDelim = TEXT("\n");
 #endif
+
+	/** Maximum length of the files appended to a command line, above which the list of files is split into chunks */
+	const int32 MaxChunkFilesLen = 8000;
+
+	/** Minimum number of files in a chunk, below which it is not worth sending them to another 'cm shell' */
+	const int32 MinChunkFiles = 16;
+
+	/**
+	 * Minimum number of files of a directory for a single "status" of the whole directory to be cheaper than one "status" per file,
+	 * the status of a directory being recursive (listing all the private and ignored files of its subtree)
+	 */
+	const int32 MinDirectoryStatusFiles = 16;
 }
 
 FScopedTempFile::FScopedTempFile(const FText& InText)
@@ -46,220 +60,480 @@ const FString& FScopedTempFile::GetFilename() const
 	return Filename;
 }
 
-// Needed to SetHandleInformation() on WritePipe for input (opposite of ReadPipe, for output) (idem FInteractiveProcess)
-static FORCEINLINE bool CreatePipeWrite(void*& ReadPipe, void*& WritePipe)
+// Thread local storage slot of the cancel flag of the operation run by each thread
+static uint32 GetCancelFlagTlsSlot()
 {
-#if PLATFORM_WINDOWS
-	SECURITY_ATTRIBUTES Attr = { sizeof(SECURITY_ATTRIBUTES), NULL, true };
+	static const uint32 TlsSlot = FPlatformTLS::AllocTlsSlot();
+	return TlsSlot;
+}
 
-	if (!::CreatePipe(&ReadPipe, &WritePipe, &Attr, 0))
-	{
-		return false;
-	}
+FScopedPlasticCancellation::FScopedPlasticCancellation(const volatile int32* InCancelFlag)
+	: PreviousCancelFlag(GetCancelFlag())
+{
+	FPlatformTLS::SetTlsValue(GetCancelFlagTlsSlot(), const_cast<int32*>(InCancelFlag));
+}
 
-	if (!::SetHandleInformation(WritePipe, HANDLE_FLAG_INHERIT, 0))
-	{
-		return false;
-	}
+FScopedPlasticCancellation::~FScopedPlasticCancellation()
+{
+	FPlatformTLS::SetTlsValue(GetCancelFlagTlsSlot(), const_cast<int32*>(PreviousCancelFlag));
+}
 
-	return true;
-#else
-	return FPlatformProcess::CreatePipe(ReadPipe, WritePipe);
-#endif // PLATFORM_WINDOWS
+const volatile int32* FScopedPlasticCancellation::GetCancelFlag()
+{
+	return static_cast<const volatile int32*>(FPlatformTLS::GetTlsValue(GetCancelFlagTlsSlot()));
 }
 
-namespace PlasticSourceControlUtils
+// Thread local storage slot of the priority of the operation run by each thread (stored shifted by one, null meaning none registered)
+static uint32 GetCommandPriorityTlsSlot()
 {
-// In/Out Pipes for the 'cm shell' persistent process
-static void*		ShellOutputPipeRead = nullptr;
-static void*		ShellOutputPipeWrite = nullptr;
-static void*		ShellInputPipeRead = nullptr;
-static void*		ShellInputPipeWrite = nullptr;
-static FProcHandle	ShellProcessHandle;
+	static const uint32 TlsSlot = FPlatformTLS::AllocTlsSlot();
+	return TlsSlot;
+}
 
-static void CleanupBackgroundCommandLineShell()
+static void SetCommandPriority(const EPlasticCommandPriority::Type InPriority)
 {
-	FPlatformProcess::ClosePipe(ShellInputPipeRead, ShellInputPipeWrite);
-	FPlatformProcess::ClosePipe(ShellOutputPipeRead, ShellOutputPipeWrite);
-	ShellOutputPipeRead = ShellOutputPipeWrite = nullptr;
-	ShellInputPipeRead = ShellInputPipeWrite = nullptr;
+	FPlatformTLS::SetTlsValue(GetCommandPriorityTlsSlot(), reinterpret_cast<void*>(static_cast<UPTRINT>(InPriority) + 1));
 }
 
-// Launch the Plastic SCM background 'cm shell' process in background for optimized successive commands,
-// if possible (and not already running)
-bool LaunchBackgroundPlasticShell(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory)
+FScopedPlasticCommandPriority::FScopedPlasticCommandPriority(const EPlasticCommandPriority::Type InPriority)
+	: PreviousPriority(GetPriority())
 {
-	// only if shell not already running
-	if (!ShellProcessHandle.IsValid())
-	{
-		const FString FullCommand(TEXT("shell"));
+	SetCommandPriority(InPriority);
+}
 
-		const bool bLaunchDetached = false;				// the new process will NOT have its own window
-		const bool bLaunchHidden = true;				// the new process will be minimized in the task bar
-		const bool bLaunchReallyHidden = bLaunchHidden; // the new process will not have a window or be in the task bar
+FScopedPlasticCommandPriority::~FScopedPlasticCommandPriority()
+{
+	SetCommandPriority(PreviousPriority);
+}
 
-		verify(FPlatformProcess::CreatePipe(ShellOutputPipeRead, ShellOutputPipeWrite));	// For reading from child process
-		verify(CreatePipeWrite(ShellInputPipeRead, ShellInputPipeWrite));	// For writing to child process
+EPlasticCommandPriority::Type FScopedPlasticCommandPriority::GetPriority()
+{
+	const UPTRINT Value = reinterpret_cast<UPTRINT>(FPlatformTLS::GetTlsValue(GetCommandPriorityTlsSlot()));
+	return (Value != 0) ? static_cast<EPlasticCommandPriority::Type>(Value - 1) : EPlasticCommandPriority::Interactive;
+}
 
-		UE_LOG(LogSourceControl, Log, TEXT("LaunchBackgroundPlasticShell: '%s %s'"), *InPathToPlasticBinary, *FullCommand);
-		ShellProcessHandle = FPlatformProcess::CreateProc(*InPathToPlasticBinary, *FullCommand, bLaunchDetached, bLaunchHidden, bLaunchReallyHidden, nullptr, 0, *InWorkingDirectory, ShellOutputPipeWrite, ShellInputPipeRead);
-		if (!ShellProcessHandle.IsValid())
-		{
-			UE_LOG(LogSourceControl, Warning, TEXT("Failed to launch 'cm shell'")); // not a bug, just no Plastic SCM cli found
-			CleanupBackgroundCommandLineShell();
-		}
-	}
+namespace PlasticSourceControlUtils
+{
+// Number of interactive commands pending or running, to which background commands yield between their chunks
+static FThreadSafeCounter NbInteractiveCommands;
 
-	return ShellProcessHandle.IsValid();
-}
+// Pool of 'cm shell' persistent processes, leased to each command running concurrently
+static FPlasticSourceControlShellPool ShellPool;
+
+// Connection health monitor, running its 'checkconnection' heartbeat on the pool
+static FPlasticSourceControlConnectionMonitor ConnectionMonitor;
 
-static void RestartBackgroundCommandLineShell()
+// Facts immutable for the session, memoized by RunProbe()
+static FCriticalSection MemoizedCriticalSection;
+static FString MemoizedPlasticScmVersion;
+static FString MemoizedUserName;
+
+// Launch the pool of Plastic SCM background 'cm shell' processes for optimized successive commands,
+// if possible (and not already running)
+bool LaunchBackgroundPlasticShell(const FString& InPathToPlasticBinary, const FString& InWorkingDirectory, const int32 InPoolSize)
 {
-	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
-	const FString& PathToPlasticBinary = PlasticSourceControl.AccessSettings().GetBinaryPath();
-	const FString& WorkingDirectory = PlasticSourceControl.GetProvider().GetPathToWorkspaceRoot();
+	const bool bLaunched = ShellPool.Launch(InPathToPlasticBinary, InWorkingDirectory, InPoolSize);
+	if (bLaunched)
+	{
+		ConnectionMonitor.Launch(InWorkingDirectory);
+	}
+	return bLaunched;
+}
 
-	FPlatformProcess::CloseProc(ShellProcessHandle);
-	CleanupBackgroundCommandLineShell();
-	LaunchBackgroundPlasticShell(PathToPlasticBinary, WorkingDirectory);
+// Commands only reading the state of the workspace, that can thus be aborted and retried safely after a timeout
+bool IsRetryableCommand(const FString& InCommand)
+{
+	return InCommand.Equals(TEXT("status")) || InCommand.Equals(TEXT("fileinfo")) || InCommand.Equals(TEXT("history")) || InCommand.Equals(TEXT("log"))
+		|| InCommand.Equals(TEXT("ls")) || InCommand.Equals(TEXT("whoami")) || InCommand.Equals(TEXT("version")) || InCommand.Equals(TEXT("getworkspacefrompath")) || InCommand.Equals(TEXT("checkconnection"));
 }
 
+// Lease a free 'cm shell' from the pool to run the command, and release it right after
 bool RunCommandInternal(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, FString& OutResults, FString& OutErrors)
 {
 	bool bResult = false;
+	bool bRetry = false;
 
-	if (ShellProcessHandle.IsValid())
 	{
-		// Detect previous crash of cm.exe and restart 'cm shell'
-		if (!FPlatformProcess::IsProcRunning(ShellProcessHandle))
+		FScopedPlasticShell Shell(ShellPool, FScopedPlasticCancellation::GetCancelFlag(), FScopedPlasticCommandPriority::IsInteractive());
+		if (Shell.IsValid())
+		{
+			bResult = Shell->RunCommand(InCommand, InParameters, InFiles, OutResults, OutErrors);
+			bRetry = !bResult && Shell->HasTimedOut() && IsRetryableCommand(InCommand);
+		}
+		else
 		{
-			UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal: 'cm shell' has stopped. Restarting!"), FPlatformProcess::IsProcRunning(ShellProcessHandle));
-			RestartBackgroundCommandLineShell();
+			UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal(%s): cm shell not running"), *InCommand);
+			OutErrors = InCommand + ": Plastic SCM shell not running!";
 		}
+	}
 
-		// Start with the Plastic command itself ("status", "log", "chekin"...)
-		FString FullCommand = InCommand;
-		// Append to the command all parameters, and then finally the files
-		for (const FString& Parameter : InParameters)
+	if (bRetry)
+	{
+		// The 'cm shell' was wedged and has been aborted by the watchdog: retry once on a fresh one (the aborted one being restarted when leased)
+		UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal(%s): retrying after timeout"), *InCommand);
+		OutResults.Empty();
+		OutErrors.Empty();
+		FScopedPlasticShell Shell(ShellPool, FScopedPlasticCancellation::GetCancelFlag(), FScopedPlasticCommandPriority::IsInteractive());
+		if (Shell.IsValid())
 		{
-			FullCommand += TEXT(" ");
-			FullCommand += Parameter;
+			bResult = Shell->RunCommand(InCommand, InParameters, InFiles, OutResults, OutErrors);
 		}
-		for (const FString& File : InFiles)
+		else
 		{
-			FullCommand += TEXT(" \"");
-			FullCommand += File;
-			FullCommand += TEXT("\"");
+			OutErrors = InCommand + ": Plastic SCM shell not running!";
 		}
-		// @todo: temporary debug logs (before end of line)
-		UE_LOG(LogSourceControl, Log, TEXT("RunCommandInternal: '%s'"), *FullCommand);
-		FullCommand += TEXT('\n'); // Finalize the command line
+	}
 
-		// Send command to 'cm shell' process
-		const bool bWriteOk = FPlatformProcess::WritePipe(ShellInputPipeWrite, FullCommand);
+	return bResult;
+}
 
-		// And wait up to 60 seconds for any kind of output from cm shell: in case of lengthier operation, intermediate output (like percentage of progress) is expected, which would refresh the timout
-		const double Timeout = 60.0;
-		const double StartTimestamp = FPlatformTime::Seconds();
-		double LastActivity = StartTimestamp;
-		int32 PreviousLogLen = 0;
-		while (FPlatformProcess::IsProcRunning(ShellProcessHandle))
-		{
-			FString Output = FPlatformProcess::ReadPipe(ShellOutputPipeRead);
-			if (0 < Output.Len())
-			{
-				LastActivity = FPlatformTime::Seconds(); // freshen the timestamp while cm is still actively outputting information
-				OutResults.Append(MoveTemp(Output));
-				// Search the output for the line containing the result code, also indicating the end of the command
-				const uint32 IndexCommandResult = OutResults.Find(TEXT("CommandResult "), ESearchCase::CaseSensitive, ESearchDir::FromEnd);
-				if (INDEX_NONE != IndexCommandResult)
-				{
-					const uint32 IndexEndResult = OutResults.Find(PlasticSourceControlConstants::pchDelim, ESearchCase::CaseSensitive, ESearchDir::FromStart, IndexCommandResult + 14);
-					if (INDEX_NONE != IndexEndResult)
-					{
-						const FString Result = OutResults.Mid(IndexCommandResult + 14, IndexEndResult - IndexCommandResult - 14);
-						const int32 ResultCode = FCString::Atoi(*Result);
-						bResult = (0 == ResultCode);
-						// remove the CommandResult line from the OutResults
-						OutResults.RemoveAt(IndexCommandResult, OutResults.Len() - IndexCommandResult);
-						break;
-					}
-				}
-			}
-			else if (FPlatformTime::Seconds() - LastActivity > Timeout)
-			{
-				// Shut-down and restart the connexion to 'cm shell' in case of timeout!
-				UE_LOG(LogSourceControl, Warning, TEXT("RunCommandInternal(%s)=%d TIMEOUT after '%lf's Out=\n%s"), *InCommand, bResult, (FPlatformTime::Seconds() - StartTimestamp), *OutResults.Mid(PreviousLogLen));
-				PreviousLogLen = OutResults.Len();
-				LastActivity = FPlatformTime::Seconds(); // freshen the timestamp to reinit timeout warning
-			}
+// Terminate the background 'cm shell' processes and associated pipes
+void Terminate()
+{
+	// the heartbeat runs its commands on the pool: stop it first
+	ConnectionMonitor.Terminate();
+	ShellPool.Terminate();
+
+	// the next session can use another Plastic binary or user
+	FScopeLock ScopeLock(&MemoizedCriticalSection);
+	MemoizedPlasticScmVersion.Empty();
+	MemoizedUserName.Empty();
+}
 
-			FPlatformProcess::Sleep(0.0f); // 0.0 means release the current time slice to let other threads get some attention
-		}
-		if (!InCommand.Equals(TEXT("exit")) && !FPlatformProcess::IsProcRunning(ShellProcessHandle))
+bool IsConnectionAlive()
+{
+	return !ConnectionMonitor.HasStatus() || ConnectionMonitor.IsReachable();
+}
+
+bool HasConnectionStatus()
+{
+	return ConnectionMonitor.HasStatus();
+}
+
+void ReportConnectionStatus(const bool bInReachable, const double InLatency)
+{
+	ConnectionMonitor.ReportStatus(bInReachable, InLatency);
+}
+
+void RequestConnectionCheck()
+{
+	ConnectionMonitor.RequestCheck();
+}
+
+void BeginInteractiveCommand()
+{
+	NbInteractiveCommands.Increment();
+}
+
+void EndInteractiveCommand()
+{
+	NbInteractiveCommands.Decrement();
+}
+
+void YieldToInteractiveCommands()
+{
+	// Maximum delay a chunk of a background command waits for interactive commands, so that it is never starved
+	static const double MaxYieldDelay = 2.0;
+
+	if (FScopedPlasticCommandPriority::IsBackground() && (NbInteractiveCommands.GetValue() > 0))
+	{
+		const volatile int32* CancelFlag = FScopedPlasticCancellation::GetCancelFlag();
+		const double EndTimestamp = FPlatformTime::Seconds() + MaxYieldDelay;
+		while ((NbInteractiveCommands.GetValue() > 0) && (FPlatformTime::Seconds() < EndTimestamp) && ((CancelFlag == nullptr) || (*CancelFlag == 0)))
 		{
-			// 'cm shell' normally only terminates in case of 'exit' command. Will restart on next command.
-			UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal(%s): 'cm shell' stopped after '%lf's Out=\n%s"), *InCommand, FPlatformProcess::IsProcRunning(ShellProcessHandle), (FPlatformTime::Seconds() - StartTimestamp), *OutResults);
+			FPlatformProcess::Sleep(0.01f);
 		}
-		else
+	}
+}
+
+/**
+ * Split a list of files into chunks bounded by the length of their command line,
+ * and small enough to be spread over all the 'cm shell' of the pool.
+ */
+static void SplitFilesIntoChunks(const TArray<FString>& InFiles, TArray<TArray<FString>>& OutChunks)
+{
+	const int32 MaxFilesPerChunk = FMath::Max(PlasticSourceControlConstants::MinChunkFiles, FMath::DivideAndRoundUp(InFiles.Num(), FMath::Max(1, ShellPool.Num())));
+
+	int32 ChunkLen = 0;
+	for (const FString& File : InFiles)
+	{
+		const int32 FileLen = File.Len() + 3; // space and quotes
+		if ((OutChunks.Num() == 0) || (OutChunks.Last().Num() >= MaxFilesPerChunk) || ((ChunkLen + FileLen > PlasticSourceControlConstants::MaxChunkFilesLen) && (OutChunks.Last().Num() > 0)))
 		{
-			// @todo: temporary debug logs
-			UE_LOG(LogSourceControl, Log, TEXT("RunCommandInternal(%s)=%d in '%lf's Out=\n%s"), *InCommand, bResult, (FPlatformTime::Seconds() - StartTimestamp), *OutResults);
+			OutChunks.AddDefaulted();
+			ChunkLen = 0;
 		}
-		
-		// Return output as error if result code is an error
-		if (!bResult)
+		OutChunks.Last().Add(File);
+		ChunkLen += FileLen;
+	}
+}
+
+/**
+ * Maximum number of 'cm shell' the operation run by the current thread can lease at once:
+ * only one for a background operation, and all but the one reserved to interactive operations for a refresh
+ */
+static int32 GetMaxLeasedShells()
+{
+	switch (FScopedPlasticCommandPriority::GetPriority())
+	{
+	case EPlasticCommandPriority::Background:
+		return 1;
+	case EPlasticCommandPriority::ForegroundRefresh:
+		return FMath::Max(1, ShellPool.Num() - 1);
+	default:
+		return ShellPool.Num();
+	}
+}
+
+/**
+ * Chunks of a command fanned out to the thread pool: the calling thread and its helpers claim the chunks one after the other,
+ * so that the calling thread never waits for a helper still queued behind other commands (it then runs all the chunks by itself).
+ * The chunks block on the pipes of their 'cm shell', so they run on the thread pool, and not on the workers of the TaskGraph.
+ */
+class FPlasticChunksContext
+{
+public:
+	FPlasticChunksContext(const int32 InNum, TFunction<void(int32)>&& InWork)
+		: Num(InNum)
+		, Work(MoveTemp(InWork))
+		, AllDoneEvent(FPlatformProcess::GetSynchEventFromPool(true))
+	{
+	}
+
+	~FPlasticChunksContext()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(AllDoneEvent);
+	}
+
+	/** Run the chunks not claimed yet, signaling the calling thread when the last one is done */
+	void RunChunks()
+	{
+		for (int32 Index = NextIndex.Increment() - 1; Index < Num; Index = NextIndex.Increment() - 1)
 		{
-			OutErrors = MoveTemp(OutResults);
+			Work(Index);
+			if (NbDone.Increment() == Num)
+			{
+				AllDoneEvent->Trigger();
+			}
 		}
 	}
-	else
+
+	/** Wait for all the chunks claimed by the helpers to be done */
+	void Wait()
 	{
-		UE_LOG(LogSourceControl, Error, TEXT("RunCommandInternal(%s): cm shell not running"), *InCommand);
-		OutErrors = InCommand + ": Plastic SCM shell not running!";
+		AllDoneEvent->Wait();
 	}
 
-	return bResult;
+private:
+	const int32 Num;
+	/** Only called for a claimed chunk, while the calling thread is still waiting (so while the references it captures are valid) */
+	TFunction<void(int32)> Work;
+	FThreadSafeCounter NextIndex;
+	FThreadSafeCounter NbDone;
+	FEvent* AllDoneEvent;
+};
+
+/** Helper queued to the thread pool, sharing the chunks of a command with the calling thread (outliving it if it starts too late) */
+class FPlasticChunksWork : public IQueuedWork
+{
+public:
+	FPlasticChunksWork(const TSharedRef<FPlasticChunksContext, ESPMode::ThreadSafe>& InContext)
+		: Context(InContext)
+	{
+	}
+
+	virtual void DoThreadedWork() override
+	{
+		Context->RunChunks();
+		delete this;
+	}
+
+	virtual void Abandon() override
+	{
+		delete this;
+	}
+
+private:
+	TSharedRef<FPlasticChunksContext, ESPMode::ThreadSafe> Context;
+};
+
+/**
+ * Run the chunks of a command concurrently, on the calling thread and up to InMaxConcurrency-1 helpers of the thread pool,
+ * and wait for all of them to be done.
+ */
+static void RunChunksConcurrently(const int32 InNum, const int32 InMaxConcurrency, TFunction<void(int32)> InWork)
+{
+	if (InNum <= 0)
+	{
+		return;
+	}
+
+	TSharedRef<FPlasticChunksContext, ESPMode::ThreadSafe> Context = MakeShareable(new FPlasticChunksContext(InNum, MoveTemp(InWork)));
+	const int32 NbHelpers = (GThreadPool != nullptr) ? FMath::Min(InNum, InMaxConcurrency) - 1 : 0;
+	for (int32 Helper = 0; Helper < NbHelpers; Helper++)
+	{
+		GThreadPool->AddQueuedWork(new FPlasticChunksWork(Context));
+	}
+	Context->RunChunks();
+	Context->Wait();
+}
+
+/** Commands operating on each file independently of the others, that can thus be split into chunks of files run concurrently */
+static bool IsChunkableCommand(const FString& InCommand)
+{
+	return InCommand.Equals(TEXT("checkout")) || InCommand.Equals(TEXT("add")) || InCommand.Equals(TEXT("remove"))
+		|| InCommand.Equals(TEXT("undochange")) || InCommand.Equals(TEXT("fileinfo"));
 }
 
-static void ExitBackgroundCommandLineShell()
+// Basic parsing or results & errors from the Plastic command line process
+bool RunCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TArray<FString>& OutResults, TArray<FString>& OutErrorMessages)
 {
-	if (ShellProcessHandle.IsValid())
+	bool bResult;
+
+	TArray<TArray<FString>> Chunks;
+	if (IsChunkableCommand(InCommand))
+	{
+		SplitFilesIntoChunks(InFiles, Chunks);
+	}
+
+	if (Chunks.Num() <= 1)
+	{
+		FString Results;
+		FString Errors;
+
+		bResult = RunCommandInternal(InCommand, InParameters, InFiles, Results, Errors);
+
+		Results.ParseIntoArray(OutResults, PlasticSourceControlConstants::pchDelim, true);
+		Errors.ParseIntoArray(OutErrorMessages, PlasticSourceControlConstants::pchDelim, true);
+	}
+	else
 	{
-		// Tell the 'cm shell' to exit
-		FString Results, Errors;
-		RunCommandInternal(TEXT("exit"), TArray<FString>(), TArray<FString>(), Results, Errors);
-		// And wait up to one seconde for its termination
-		int timeout = 100;
-		while (FPlatformProcess::IsProcRunning(ShellProcessHandle) && (0 < timeout--))
+		// Run the chunks concurrently, each one on its own 'cm shell' leased from the pool (waiting for one if they are all busy)
+		TArray<FString> ChunkResults;
+		TArray<FString> ChunkErrors;
+		TArray<bool> ChunkSucceeded;
+		ChunkResults.SetNum(Chunks.Num());
+		ChunkErrors.SetNum(Chunks.Num());
+		ChunkSucceeded.SetNumZeroed(Chunks.Num());
+		const volatile int32* CancelFlag = FScopedPlasticCancellation::GetCancelFlag();
+		// a background command runs its chunks one after the other on a single 'cm shell', leaving the others to interactive commands
+		const EPlasticCommandPriority::Type Priority = FScopedPlasticCommandPriority::GetPriority();
+		RunChunksConcurrently(Chunks.Num(), GetMaxLeasedShells(), [&](int32 Index)
 		{
-			FPlatformProcess::Sleep(0.01f);
+			// the chunk can run on another thread, on behalf of the same operation
+			FScopedPlasticCancellation Cancellation(CancelFlag);
+			FScopedPlasticCommandPriority CommandPriority(Priority);
+			YieldToInteractiveCommands();
+			ChunkSucceeded[Index] = RunCommandInternal(InCommand, InParameters, Chunks[Index], ChunkResults[Index], ChunkErrors[Index]);
+		});
+
+		// Then merge their results and errors in the original order of the files
+		bResult = true;
+		for (int32 Index = 0; Index < Chunks.Num(); Index++)
+		{
+			TArray<FString> Results;
+			TArray<FString> ErrorMessages;
+			ChunkResults[Index].ParseIntoArray(Results, PlasticSourceControlConstants::pchDelim, true);
+			ChunkErrors[Index].ParseIntoArray(ErrorMessages, PlasticSourceControlConstants::pchDelim, true);
+			OutResults.Append(Results);
+			OutErrorMessages.Append(ErrorMessages);
+			bResult &= ChunkSucceeded[Index];
 		}
-		FPlatformProcess::CloseProc(ShellProcessHandle);
-		CleanupBackgroundCommandLineShell();
+		UE_LOG(LogSourceControl, Log, TEXT("RunCommand(%s): %d files split into %d chunks"), *InCommand, InFiles.Num(), Chunks.Num());
 	}
+
+	return bResult;
 }
 
-// Terminate the background 'cm shell' process and associated pipes
-void Terminate()
+// Run several Plastic commands back to back on the same 'cm shell', then split their results apart
+bool RunCommands(TArray<FPlasticPipelinedCommand>& InOutCommands)
 {
-	if (ShellProcessHandle.IsValid())
+	bool bResult = false;
+
+	FScopedPlasticShell Shell(ShellPool, FScopedPlasticCancellation::GetCancelFlag(), FScopedPlasticCommandPriority::IsInteractive());
+	if (Shell.IsValid())
 	{
-		ExitBackgroundCommandLineShell();
+		TArray<FPlasticShellCommand> ShellCommands;
+		ShellCommands.Reserve(InOutCommands.Num());
+		for (const FPlasticPipelinedCommand& Command : InOutCommands)
+		{
+			ShellCommands.Add(FPlasticShellCommand(Command.Command, FPlasticSourceControlShell::BuildCommandLine(Command.Command, Command.Parameters, Command.Files)));
+			ShellCommands.Last().LineCallback = Command.LineCallback;
+		}
+
+		Shell->RunCommands(ShellCommands);
+
+		// The 'cm shell' was wedged and has been aborted by the watchdog: retry once on a fresh one if the commands only read the workspace
+		bool bRetry = Shell->HasTimedOut();
+		for (const FPlasticPipelinedCommand& Command : InOutCommands)
+		{
+			bRetry &= IsRetryableCommand(Command.Command);
+		}
+		if (bRetry)
+		{
+			UE_LOG(LogSourceControl, Warning, TEXT("RunCommands(%d): retrying after timeout"), InOutCommands.Num());
+			Shell.Reset();
+			if (Shell.IsValid())
+			{
+				Shell->RunCommands(ShellCommands);
+			}
+			else
+			{
+				for (FPlasticShellCommand& ShellCommand : ShellCommands)
+				{
+					ShellCommand.bResult = false;
+					ShellCommand.Errors = ShellCommand.Command + TEXT(": Plastic SCM shell not running!");
+				}
+			}
+		}
+
+		bResult = true;
+		for (int32 Index = 0; Index < InOutCommands.Num(); Index++)
+		{
+			FPlasticPipelinedCommand& Command = InOutCommands[Index];
+			const FPlasticShellCommand& ShellCommand = ShellCommands[Index];
+			Command.bResult = ShellCommand.bResult;
+			if (!Command.LineCallback)
+			{
+				// else the results have already been handed to the callback, line by line
+				ShellCommand.Results.ParseIntoArray(Command.Results, PlasticSourceControlConstants::pchDelim, true);
+			}
+			ShellCommand.Errors.ParseIntoArray(Command.ErrorMessages, PlasticSourceControlConstants::pchDelim, true);
+			bResult &= Command.bResult;
+		}
+	}
+	else
+	{
+		UE_LOG(LogSourceControl, Error, TEXT("RunCommands(%d): cm shell not running"), InOutCommands.Num());
+		for (FPlasticPipelinedCommand& Command : InOutCommands)
+		{
+			Command.ErrorMessages.Add(Command.Command + ": Plastic SCM shell not running!");
+		}
 	}
+
+	return bResult;
 }
 
-// Basic parsing or results & errors from the Plastic command line process
-bool RunCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TArray<FString>& OutResults, TArray<FString>& OutErrorMessages)
+// Run a Plastic command, handing each line of its output to the caller as soon as it is received from the 'cm shell'
+bool RunCommandStreaming(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TFunctionRef<void(const FString& InLine)> InLineCallback, TArray<FString>& OutErrorMessages)
 {
-	bool bResult;
-	FString Results;
+	bool bResult = false;
 	FString Errors;
 
-	bResult = RunCommandInternal(InCommand, InParameters, InFiles, Results, Errors);
+	FScopedPlasticShell Shell(ShellPool, FScopedPlasticCancellation::GetCancelFlag(), FScopedPlasticCommandPriority::IsInteractive());
+	if (Shell.IsValid())
+	{
+		bResult = Shell->RunCommandStreaming(InCommand, InParameters, InFiles, InLineCallback, Errors);
+	}
+	else
+	{
+		UE_LOG(LogSourceControl, Error, TEXT("RunCommandStreaming(%s): cm shell not running"), *InCommand);
+		Errors = InCommand + ": Plastic SCM shell not running!";
+	}
 
-	Results.ParseIntoArray(OutResults, PlasticSourceControlConstants::pchDelim, true);
-	Errors.ParseIntoArray(OutErrorMessages, PlasticSourceControlConstants::pchDelim, true);
+	TArray<FString> ErrorMessages;
+	Errors.ParseIntoArray(ErrorMessages, PlasticSourceControlConstants::pchDelim, true);
+	OutErrorMessages.Append(ErrorMessages);
 
 	return bResult;
 }
@@ -315,380 +589,1135 @@ bool FindRootDirectory(const FString& InPath, FString& OutWorkspaceRoot)
 	{
 		OutWorkspaceRoot = InPath; // If not found, return the provided dir as best possible root.
 	}
-	return bFound;
+	return bFound;
+}
+
+void GetPlasticScmVersion(FString& OutPlasticScmVersion)
+{
+	FPlasticProbe Probe;
+	RunProbe(FString(), Probe);
+	OutPlasticScmVersion = Probe.PlasticScmVersion;
+}
+
+void GetUserName(FString& OutUserName)
+{
+	FPlasticProbe Probe;
+	RunProbe(FString(), Probe);
+	OutUserName = Probe.UserName;
+}
+
+bool GetWorkspaceName(const FString& InWorkspaceRoot, FString& OutWorkspaceName)
+{
+	TArray<FString> InfoMessages;
+	TArray<FString> ErrorMessages;
+	TArray<FString> Parameters;
+	Parameters.Add(TEXT("--format={0}"));
+	TArray<FString> Files;
+	Files.Add(InWorkspaceRoot);
+	// Get the workspace name
+	const bool bResult = RunCommand(TEXT("getworkspacefrompath"), Parameters, Files, InfoMessages, ErrorMessages);
+	if (bResult && InfoMessages.Num() > 0)
+	{
+		OutWorkspaceName = MoveTemp(InfoMessages[0]);
+	}
+
+	return bResult;
+}
+
+/**
+ * Parse the workspace status, looking like "cs:41@rep:UE4PlasticPlugin@repserver:localhost:8087"
+ */
+static bool ParseWorkspaceStatus(const FString& InWorkspaceStatus, int32& OutChangeset, FString& OutRepositoryName, FString& OutServerUrl)
+{
+	static const FString Changeset(TEXT("cs:"));
+	static const FString Rep(TEXT("rep:"));
+	static const FString Server(TEXT("repserver:"));
+	TArray<FString> RepositorySpecification;
+	InWorkspaceStatus.ParseIntoArray(RepositorySpecification, TEXT("@"));
+	if (3 <= RepositorySpecification.Num())
+	{
+		OutChangeset = FCString::Atoi(*RepositorySpecification[0].RightChop(Changeset.Len()));
+		OutRepositoryName = RepositorySpecification[1].RightChop(Rep.Len());
+		OutServerUrl = RepositorySpecification[2].RightChop(Server.Len());
+		return true;
+	}
+	return false;
+}
+
+bool GetRepositorySpecification(const FString& InWorkspaceRoot, FString& OutRepositoryName, FString& OutServerUrl) 
+{
+	TArray<FString> InfoMessages;
+	TArray<FString> ErrorMessages;
+	TArray<FString> Parameters;
+	Parameters.Add(TEXT("--nochanges"));
+	TArray<FString> Files;
+	Files.Add(InWorkspaceRoot);
+	// Get the workspace status, looking like "cs:41@rep:UE4PlasticPlugin@repserver:localhost:8087"
+	bool bResult = RunCommand(TEXT("status"), Parameters, Files, InfoMessages, ErrorMessages);
+	if (bResult && InfoMessages.Num() > 0)
+	{
+		int32 Changeset;
+		bResult = ParseWorkspaceStatus(InfoMessages[0], Changeset, OutRepositoryName, OutServerUrl);
+	}
+
+	return bResult;
+}
+
+// Gather all the requested facts in one pipelined exchange with a 'cm shell'
+bool RunProbe(const FString& InWorkspaceRoot, FPlasticProbe& InOutProbe)
+{
+	{
+		FScopeLock ScopeLock(&MemoizedCriticalSection);
+		InOutProbe.PlasticScmVersion = MemoizedPlasticScmVersion;
+		InOutProbe.UserName = MemoizedUserName;
+	}
+
+	TArray<FString> Files;
+	Files.Add(InWorkspaceRoot);
+
+	// Build the list of commands, remembering the index of each one (if any)
+	TArray<FPlasticPipelinedCommand> Commands;
+	int32 VersionIndex = INDEX_NONE;
+	int32 WhoamiIndex = INDEX_NONE;
+	int32 WorkspaceNameIndex = INDEX_NONE;
+	int32 WorkspaceStatusIndex = INDEX_NONE;
+	int32 BranchNameIndex = INDEX_NONE;
+	int32 CheckConnectionIndex = INDEX_NONE;
+	if (InOutProbe.PlasticScmVersion.IsEmpty())
+	{
+		VersionIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("version"), TArray<FString>(), TArray<FString>()));
+	}
+	if (InOutProbe.UserName.IsEmpty())
+	{
+		WhoamiIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("whoami"), TArray<FString>(), TArray<FString>()));
+	}
+	if (InOutProbe.bGetWorkspaceName)
+	{
+		TArray<FString> Parameters;
+		Parameters.Add(TEXT("--format={0}"));
+		WorkspaceNameIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("getworkspacefrompath"), Parameters, Files));
+	}
+	if (InOutProbe.bGetWorkspaceStatus)
+	{
+		TArray<FString> Parameters;
+		Parameters.Add(TEXT("--nochanges"));
+		WorkspaceStatusIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("status"), Parameters, Files));
+	}
+	if (InOutProbe.bGetBranchName)
+	{
+		TArray<FString> Parameters;
+		Parameters.Add(TEXT("--wkconfig"));
+		Parameters.Add(TEXT("--nochanges"));
+		Parameters.Add(TEXT("--nostatus"));
+		BranchNameIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("status"), Parameters, Files));
+	}
+	if (InOutProbe.bCheckConnection)
+	{
+		CheckConnectionIndex = Commands.Add(FPlasticPipelinedCommand(TEXT("checkconnection"), TArray<FString>(), Files));
+	}
+
+	if (Commands.Num() == 0)
+	{
+		return true; // everything memoized
+	}
+
+	const bool bResult = RunCommands(Commands);
+
+	// First result line of a command, if it succeeded
+	auto FirstResult = [&Commands](const int32 InIndex, FString& OutResult)
+	{
+		if ((InIndex != INDEX_NONE) && Commands[InIndex].bResult && (Commands[InIndex].Results.Num() > 0))
+		{
+			OutResult = Commands[InIndex].Results[0];
+		}
+	};
+
+	FirstResult(VersionIndex, InOutProbe.PlasticScmVersion);
+	FirstResult(WhoamiIndex, InOutProbe.UserName);
+	FirstResult(WorkspaceNameIndex, InOutProbe.WorkspaceName);
+	FirstResult(BranchNameIndex, InOutProbe.BranchName);
+	if (WorkspaceStatusIndex != INDEX_NONE)
+	{
+		FPlasticPipelinedCommand& StatusCommand = Commands[WorkspaceStatusIndex];
+		InOutProbe.bWorkspaceStatusOk = StatusCommand.bResult;
+		if (StatusCommand.bResult && (StatusCommand.Results.Num() > 0))
+		{
+			ParseWorkspaceStatus(StatusCommand.Results[0], InOutProbe.Changeset, InOutProbe.RepositoryName, InOutProbe.ServerUrl);
+		}
+		InOutProbe.WorkspaceStatusMessages = MoveTemp(StatusCommand.Results);
+		InOutProbe.WorkspaceStatusErrors = MoveTemp(StatusCommand.ErrorMessages);
+	}
+	if (CheckConnectionIndex != INDEX_NONE)
+	{
+		FPlasticPipelinedCommand& CheckConnectionCommand = Commands[CheckConnectionIndex];
+		InOutProbe.bConnectionOk = CheckConnectionCommand.bResult;
+		InOutProbe.ConnectionMessages = MoveTemp(CheckConnectionCommand.Results);
+		InOutProbe.ConnectionErrors = MoveTemp(CheckConnectionCommand.ErrorMessages);
+	}
+
+	{
+		FScopeLock ScopeLock(&MemoizedCriticalSection);
+		MemoizedPlasticScmVersion = InOutProbe.PlasticScmVersion;
+		MemoizedUserName = InOutProbe.UserName;
+	}
+
+	return bResult;
+}
+
+/**
+ * Parse the content of the "plastic.workspace" file: the name of the workspace on the first line, followed by its GUID, like that:
+UE4PlasticPluginDev
+b8a2e1c4-33f5-4a8e-8b4c-5f1b7e0b2a9d
+*/
+bool ReadWorkspaceName(const FString& InWorkspaceRoot, FString& OutWorkspaceName)
+{
+	FString Content;
+	if (!FFileHelper::LoadFileToString(Content, *(InWorkspaceRoot / TEXT(".plastic/plastic.workspace"))))
+	{
+		return false;
+	}
+
+	TArray<FString> Lines;
+	Content.ParseIntoArrayLines(Lines, true);
+	if (Lines.Num() < 1)
+	{
+		return false;
+	}
+	OutWorkspaceName = Lines[0].Trim().TrimTrailing();
+	return !OutWorkspaceName.IsEmpty();
+}
+
+/**
+ * Parse the content of the "plastic.selector" file: a list of keywords each followed by a value between quotes, like that:
+repository "UE4PlasticPlugin@localhost:8087"
+  path "/"
+    smartbranch "/main"
+ *
+ * or with the short form of the keywords ("rep", "br") and a regular branch.
+ * Any selector on a label or a changeset, or without the server of the repository, is left to cm.
+*/
+bool ReadWorkspaceSelector(const FString& InWorkspaceRoot, FString& OutRepositoryName, FString& OutServerUrl, FString& OutBranchName)
+{
+	FString Content;
+	if (!FFileHelper::LoadFileToString(Content, *(InWorkspaceRoot / TEXT(".plastic/plastic.selector"))))
+	{
+		return false;
+	}
+
+	FString RepositorySpec;
+	FString Branch;
+	FString Keyword;
+	const TCHAR* Char = *Content;
+	while (*Char != TEXT('\0'))
+	{
+		if (FChar::IsWhitespace(*Char))
+		{
+			Char++;
+		}
+		else if (*Char == TEXT('"'))
+		{
+			// Value of the previous keyword
+			const TCHAR* ValueStart = ++Char;
+			while ((*Char != TEXT('\0')) && (*Char != TEXT('"')))
+			{
+				Char++;
+			}
+			if (*Char != TEXT('"'))
+			{
+				return false; // unterminated value
+			}
+			const FString Value(static_cast<int32>(Char - ValueStart), ValueStart);
+			Char++;
+
+			if (Keyword.Equals(TEXT("repository")) || Keyword.Equals(TEXT("rep")))
+			{
+				RepositorySpec = Value;
+			}
+			else if (Keyword.Equals(TEXT("smartbranch")) || Keyword.Equals(TEXT("branch")) || Keyword.Equals(TEXT("br")))
+			{
+				Branch = Value;
+			}
+			else if (Keyword.Equals(TEXT("label")) || Keyword.Equals(TEXT("lb")) || Keyword.Equals(TEXT("changeset")) || Keyword.Equals(TEXT("cs")))
+			{
+				return false; // not on a branch: unknown format for us
+			}
+			Keyword.Empty();
+		}
+		else
+		{
+			const TCHAR* KeywordStart = Char;
+			while ((*Char != TEXT('\0')) && !FChar::IsWhitespace(*Char) && (*Char != TEXT('"')))
+			{
+				Char++;
+			}
+			Keyword = FString(static_cast<int32>(Char - KeywordStart), KeywordStart).ToLower();
+		}
+	}
+
+	// The repository is specified as "name@server", the server being optional (then the default one, only known by cm)
+	FString RepositoryName;
+	FString ServerUrl;
+	if (Branch.IsEmpty() || !RepositorySpec.Split(TEXT("@"), &RepositoryName, &ServerUrl) || RepositoryName.IsEmpty() || ServerUrl.IsEmpty())
+	{
+		return false;
+	}
+
+	OutRepositoryName = RepositoryName;
+	OutServerUrl = ServerUrl;
+	OutBranchName = FString::Printf(TEXT("Branch %s@%s@%s"), *Branch, *RepositoryName, *ServerUrl);
+	return true;
+}
+
+void GetBranchName(const FString& InWorkspaceRoot, FString& OutBranchName)
+{
+	TArray<FString> InfoMessages;
+	TArray<FString> ErrorMessages;
+	TArray<FString> Parameters;
+	Parameters.Add(TEXT("--wkconfig"));
+	Parameters.Add(TEXT("--nochanges"));
+	Parameters.Add(TEXT("--nostatus"));
+	TArray<FString> Files;
+	Files.Add(InWorkspaceRoot);
+	const bool bResult = RunCommand(TEXT("status"), Parameters, Files, InfoMessages, ErrorMessages);
+	if(bResult && InfoMessages.Num() > 0)
+	{
+		OutBranchName = InfoMessages[0];
+	}
+}
+
+/** Key of a two characters status code, as used by the case labels of FPlasticStatusParser::StateFromCode() */
+#define PLASTIC_STATUS_CODE(C0, C1) ((static_cast<uint32>(C0) << 16) | static_cast<uint32>(C1))
+
+/**
+ * Extract and interpret the file state from one line of a Plastic "status" result, in a single pass over its characters
+ * without any copy nor allocation: the filenames are views into the line, that must thus outlive the parser,
+ * only normalized into a string when needed (to look up the file, or to store its state).
+ *
+ * empty string = unmodified/controlled or hidden changes
+ CH C:\Workspace\UE4PlasticPlugin\Content\Changed_BP.uasset
+ CO C:\Workspace\UE4PlasticPlugin\Content\CheckedOut_BP.uasset
+ CP C:\Workspace\UE4PlasticPlugin\Content\Copied_BP.uasset
+ RP C:\Workspace\UE4PlasticPlugin\Content\Replaced_BP.uasset
+ AD C:\Workspace\UE4PlasticPlugin\Content\Added_BP.uasset
+ PR C:\Workspace\UE4PlasticPlugin\Content\Private_BP.uasset
+ IG C:\Workspace\UE4PlasticPlugin\Content\Ignored_BP.uasset
+ DE C:\Workspace\UE4PlasticPlugin\Content\Deleted_BP.uasset
+ LD C:\Workspace\UE4PlasticPlugin\Content\Deleted2_BP.uasset
+ MV 100% C:\Workspace\UE4PlasticPlugin\Content\ToMove_BP.uasset -> C:\Workspace\UE4PlasticPlugin\Content\Moved_BP.uasset
+ LM 100% C:\Workspace\UE4PlasticPlugin\Content\ToMove2_BP.uasset -> C:\Workspace\UE4PlasticPlugin\Content\Moved2_BP.uasset
+
+ TODO: Conflicted files?
+*/
+class FPlasticStatusParser
+{
+public:
+	explicit FPlasticStatusParser(const FString& InResult)
+	{
+		Parse(*InResult, *InResult + InResult.Len());
+	}
+
+	/** The filename of the line, normalized, being the destination of a move */
+	FString GetFilename() const
+	{
+		FString Result;
+		GetFilename(Result);
+		return Result;
+	}
+
+	/** The filename of the line, normalized into a reused string (without any allocation once it is large enough) */
+	void GetFilename(FString& OutFilename) const
+	{
+		OutFilename.Reset(FilenameLen);
+		OutFilename.AppendChars(Filename, FilenameLen);
+		FPaths::NormalizeFilename(OutFilename);
+	}
+
+	/** The original filename of a move, normalized, or an empty string */
+	FString GetMovedFrom() const
+	{
+		FString Result(MovedFromLen, MovedFrom);
+		FPaths::NormalizeFilename(Result);
+		return Result;
+	}
+
+	EWorkspaceState::Type State;
+
+	/** Similarity percentage between the original and the destination of a move, or -1 */
+	int32 Similarity;
+
+	/** View of the filename (the destination of a move) */
+	const TCHAR* Filename;
+	int32 FilenameLen;
+
+	/** View of the original filename of a move (empty otherwise) */
+	const TCHAR* MovedFrom;
+	int32 MovedFromLen;
+
+private:
+	/** Lookup of the two characters status code, packed into a single integer to switch on it */
+	static EWorkspaceState::Type StateFromCode(const TCHAR InCode0, const TCHAR InCode1)
+	{
+		switch (PLASTIC_STATUS_CODE(InCode0, InCode1))
+		{
+		case PLASTIC_STATUS_CODE('C', 'H'): return EWorkspaceState::Changed; // Modified but not Checked-Out
+		case PLASTIC_STATUS_CODE('C', 'O'): return EWorkspaceState::CheckedOut; // Checked-Out for modification
+		case PLASTIC_STATUS_CODE('C', 'P'): return EWorkspaceState::Copied;
+		case PLASTIC_STATUS_CODE('R', 'P'): return EWorkspaceState::Replaced;
+		case PLASTIC_STATUS_CODE('A', 'D'): return EWorkspaceState::Added;
+		case PLASTIC_STATUS_CODE('P', 'R'): return EWorkspaceState::Private; // Not Controlled/Not in Depot/Untracked
+		case PLASTIC_STATUS_CODE('I', 'G'): return EWorkspaceState::Ignored;
+		// TODO: need to differentiate for CanEdit/CanCheckout/CanCheckIn?
+		case PLASTIC_STATUS_CODE('D', 'E'): // Deleted
+		case PLASTIC_STATUS_CODE('L', 'D'): return EWorkspaceState::Deleted; // Locally Deleted (ie. missing)
+		// TODO: need to differentiate for CanEdit/CanCheckout/CanCheckIn?
+		case PLASTIC_STATUS_CODE('M', 'V'): // Moved/Renamed
+		case PLASTIC_STATUS_CODE('L', 'M'): return EWorkspaceState::Moved; // Locally Moved
+		default: return EWorkspaceState::Unknown;
+		}
+	}
+
+	void Parse(const TCHAR* InLineBegin, const TCHAR* InLineEnd)
+	{
+		State = EWorkspaceState::Unknown;
+		Similarity = -1;
+		Filename = InLineEnd;
+		FilenameLen = 0;
+		MovedFrom = InLineEnd;
+		MovedFromLen = 0;
+
+		// " XX " status code, after some indentation
+		const TCHAR* Char = InLineBegin;
+		while ((Char < InLineEnd) && (*Char == TEXT(' ')))
+		{
+			Char++;
+		}
+		if (InLineEnd - Char >= 3)
+		{
+			State = StateFromCode(Char[0], Char[1]);
+		}
+		if (State == EWorkspaceState::Unknown)
+		{
+			// the line being a view, that may not be null-terminated
+			UE_LOG(LogSourceControl, Warning, TEXT("Unknown status '%s'"), *FString(static_cast<int32>(InLineEnd - InLineBegin), InLineBegin));
+			return;
+		}
+		Char += 3;
+
+		if (State == EWorkspaceState::Moved)
+		{
+			// "100% original -> destination"
+			int32 Percentage = 0;
+			const TCHAR* Digits = Char;
+			while ((Char < InLineEnd) && FChar::IsDigit(*Char))
+			{
+				Percentage = Percentage * 10 + (*Char - TEXT('0'));
+				Char++;
+			}
+			if ((Char > Digits) && (Char < InLineEnd) && (*Char == TEXT('%')))
+			{
+				Similarity = Percentage;
+				Char++;
+				while ((Char < InLineEnd) && (*Char == TEXT(' ')))
+				{
+					Char++;
+				}
+			}
+			else
+			{
+				Char = Digits;
+			}
+			for (const TCHAR* Arrow = Char; Arrow + 4 <= InLineEnd; Arrow++)
+			{
+				if ((Arrow[0] == TEXT(' ')) && (Arrow[1] == TEXT('-')) && (Arrow[2] == TEXT('>')) && (Arrow[3] == TEXT(' ')))
+				{
+					MovedFrom = Char;
+					MovedFromLen = static_cast<int32>(Arrow - Char);
+					Char = Arrow + 4;
+					break;
+				}
+			}
+		}
+
+		Filename = Char;
+		FilenameLen = static_cast<int32>(InLineEnd - Filename);
+	}
+};
+
+#undef PLASTIC_STATUS_CODE
+
+// Parse the fileinfo output format "{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere};{ClientPath}"
+// the absolute filename coming last as it is the only field that can itself contain a ';'
+// in a single pass over its characters without any copy nor allocation (like FPlasticStatusParser)
+class FPlasticFileinfoParser
+{
+public:
+	explicit FPlasticFileinfoParser(const FString& InResult)
+		: RevisionChangeset(-1)
+		, RevisionHeadChangeset(-1)
+		, bValid(false)
+	{
+		// Do not cull empty fields, the lock ones being empty for most of the files
+		const TCHAR* Fields[4];
+		int32 FieldsLen[4];
+		int32 NbFields = 0;
+		const TCHAR* const LineEnd = *InResult + InResult.Len();
+		const TCHAR* FieldStart = *InResult;
+		for (const TCHAR* Char = FieldStart; (Char < LineEnd) && (NbFields < 4); Char++)
+		{
+			if (*Char == TEXT(';'))
+			{
+				Fields[NbFields] = FieldStart;
+				FieldsLen[NbFields] = static_cast<int32>(Char - FieldStart);
+				NbFields++;
+				FieldStart = Char + 1;
+			}
+		}
+		if (NbFields == 4)
+		{
+			// the numbers end with their ';' separator
+			RevisionChangeset = FCString::Atoi(Fields[0]);
+			RevisionHeadChangeset = FCString::Atoi(Fields[1]);
+			LockedBy = Fields[2];
+			LockedByLen = FieldsLen[2];
+			LockedWhere = Fields[3];
+			LockedWhereLen = FieldsLen[3];
+			Filename = FieldStart;
+			FilenameLen = static_cast<int32>(LineEnd - FieldStart);
+			bValid = true;
+		}
+	}
+
+	/** The filename of the line, normalized into a reused string (without any allocation once it is large enough) */
+	void GetFilename(FString& OutFilename) const
+	{
+		OutFilename.Reset(FilenameLen);
+		if (bValid)
+		{
+			OutFilename.AppendChars(Filename, FilenameLen);
+			FPaths::NormalizeFilename(OutFilename);
+		}
+	}
+
+	int32 RevisionChangeset;
+	int32 RevisionHeadChangeset;
+
+	/** Views of the lock fields, usually empty, and of the filename */
+	const TCHAR* LockedBy;
+	int32 LockedByLen;
+	const TCHAR* LockedWhere;
+	int32 LockedWhereLen;
+	const TCHAR* Filename;
+	int32 FilenameLen;
+
+	/** Has the line the expected number of fields */
+	bool bValid;
+};
+
+/** Files of one directory to update the status of, into which the results of the commands are merged as they are streamed */
+struct FPlasticStatusGroup
+{
+	TArray<FString> Files;
+	/** The directory of the files */
+	FString Directory;
+	/** Run one "status" on the whole directory, instead of one per file (see MinDirectoryStatusFiles) */
+	bool bDirectoryStatus;
+	/** No need to query the group: a single file that does not exist */
+	bool bSkipped;
+	/** States of the files, Unknown until a status line is about them (written by one thread per file) */
+	TArray<FPlasticSourceControlState> States;
+	/** Index of the state of each file, by filename (read-only while the commands are running) */
+	TMap<FString, int32> IndexOfFiles;
+	/** State of the directory itself (or of one of its parents) when Private or Ignored, reported as a single line for the whole folder */
+	EWorkspaceState::Type InheritedState;
+	bool bStatusResult;
+	/** Index of the states of the files without any result at all, to query individually */
+	TArray<int32> UnresolvedFiles;
+};
+
+/**
+ * Merge one line of the results of a 'cm status --nostatus --noheaders --all --ignored --fullpaths' command on a directory (or on a file)
+ * into the state of the requested file it is about, if any, looked up by its absolute filename (normalized into a reused string).
+ * The results of the 'cm fileinfo --format="{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere};{ClientPath}"' command
+ * on the requested files of this directory are merged the same way (see ParseFileinfoResult), each line as soon as it is received.
+ *
+ * Example cm status results:
+ CH C:\Workspace\UE4PlasticPlugin\Content\Changed_BP.uasset
+ CO C:\Workspace\UE4PlasticPlugin\Content\CheckedOut_BP.uasset
+ CP C:\Workspace\UE4PlasticPlugin\Content\Copied_BP.uasset
+ RP C:\Workspace\UE4PlasticPlugin\Content\Replaced_BP.uasset
+ AD C:\Workspace\UE4PlasticPlugin\Content\Added_BP.uasset
+ PR C:\Workspace\UE4PlasticPlugin\Content\Private_BP.uasset
+ IG C:\Workspace\UE4PlasticPlugin\Content\Ignored_BP.uasset
+ DE C:\Workspace\UE4PlasticPlugin\Content\Deleted_BP.uasset
+ LD C:\Workspace\UE4PlasticPlugin\Content\Deleted2_BP.uasset
+ MV 100% C:\Workspace\UE4PlasticPlugin\Content\ToMove_BP.uasset -> C:\Workspace\UE4PlasticPlugin\Content\Moved_BP.uasset
+ LM 100% C:\Workspace\UE4PlasticPlugin\Content\ToMove2_BP.uasset -> C:\Workspace\UE4PlasticPlugin\Content\Moved2_BP.uasset
+ PR C:\Workspace\UE4PlasticPlugin\Content\NewFolder
+ *
+ * Example cm fileinfo results:
+16;16;;;C:\Workspace\UE4PlasticPlugin\Content\Changed_BP.uasset
+14;15;;;C:\Workspace\UE4PlasticPlugin\Content\CheckedOut_BP.uasset
+17;17;srombauts;Workspace_2;C:\Workspace\UE4PlasticPlugin\Content\Locked_BP.uasset
+ *
+ * Lines about other files are ignored, so that neither the order of the results, nor any missing or extra line, can mix up files,
+ * except for a private or ignored folder, reported as a single line: the requested files of the directory inherit its state.
+ * A requested file without any status result is Controlled/Unchanged (or has hidden changes), provided that fileinfo knows about it.
+ */
+static void ParseStatusResult(const FString& InResult, const bool bInDirectoryStatus, FPlasticStatusGroup& InOutGroup, FString& InOutFilename)
+{
+	const FPlasticStatusParser StatusParser(InResult);
+	StatusParser.GetFilename(InOutFilename);
+	// NOTE: in case of rename by editor, there are two results for a file: checkouted AND renamed, the last one being kept
+	const int32* Index = InOutGroup.IndexOfFiles.Find(InOutFilename);
+	if (Index != nullptr)
+	{
+		InOutGroup.States[*Index].WorkspaceState = StatusParser.State;
+		if (StatusParser.MovedFromLen > 0)
+		{
+			InOutGroup.States[*Index].MovedFrom = StatusParser.GetMovedFrom();
+		}
+	}
+	else if (bInDirectoryStatus && ((StatusParser.State == EWorkspaceState::Private) || (StatusParser.State == EWorkspaceState::Ignored))
+		&& InOutGroup.Directory.StartsWith(InOutFilename) && ((InOutGroup.Directory.Len() == InOutFilename.Len()) || (InOutGroup.Directory[InOutFilename.Len()] == TEXT('/'))))
+	{
+		// the directory of the group itself, or one of its parents (only the first chunk of a group runs its status)
+		InOutGroup.InheritedState = StatusParser.State;
+	}
+}
+
+/** Merge one line of "fileinfo" results into the state of the requested file it is about, if any (see ParseStatusResult) */
+static void ParseFileinfoResult(const FString& InResult, FPlasticStatusGroup& InOutGroup, FString& InOutFilename)
+{
+	const FPlasticFileinfoParser FileinfoParser(InResult);
+	FileinfoParser.GetFilename(InOutFilename);
+	const int32* Index = InOutGroup.IndexOfFiles.Find(InOutFilename);
+	if (Index != nullptr)
+	{
+		FPlasticSourceControlState& FileState = InOutGroup.States[*Index];
+		FileState.LocalRevisionChangeset = FileinfoParser.RevisionChangeset;
+		FileState.DepotRevisionChangeset = FileinfoParser.RevisionHeadChangeset;
+		FileState.LockedBy = FString(FileinfoParser.LockedByLen, FileinfoParser.LockedBy);
+		FileState.LockedWhere = FString(FileinfoParser.LockedWhereLen, FileinfoParser.LockedWhere);
+	}
+}
+
+/** Complete the states of the requested files once both results have been merged into them, telling apart the files locked by someone else */
+static void FinalizeStatusAndFileinfoStates(TArray<FPlasticSourceControlState>& InOutStates)
+{
+	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
+	FPlasticSourceControlProvider& Provider = PlasticSourceControl.GetProvider();
+
+	for (FPlasticSourceControlState& FileState : InOutStates)
+	{
+		if ((0 < FileState.LockedBy.Len()) && ((FileState.LockedBy != Provider.GetUserName()) || (FileState.LockedWhere != Provider.GetWorkspaceName())))
+		{
+			UE_LOG(LogSourceControl, Verbose, TEXT("LockedByOther(%s) by '%s!=%s' (or %s!=%s)"), *FileState.LocalFilename, *FileState.LockedBy, *Provider.GetUserName(), *FileState.LockedWhere, *Provider.GetWorkspaceName());
+			FileState.WorkspaceState = EWorkspaceState::LockedByOther;
+		}
+		UE_LOG(LogSourceControl, Verbose, TEXT("%s = %d:%s %d;%d by '%s' (%s)"), *FileState.LocalFilename, static_cast<uint32>(FileState.WorkspaceState), FileState.ToString(),
+			FileState.LocalRevisionChangeset, FileState.DepotRevisionChangeset, *FileState.LockedBy, *FileState.LockedWhere);
+		FileState.TimeStamp.Now();
+	}
+}
+
+/** Chunk of the files of a directory, with the outcome of its own commands */
+struct FPlasticFileinfoChunk
+{
+	int32 GroupIndex;
+	bool bWithDirectoryStatus;
+	TArray<FString> Files;
+	bool bStatusResult;
+	TArray<FString> StatusErrorMessages;
+	bool bResult;
+	TArray<FString> ErrorMessages;
+};
+
+// Add one "status" command per file, streamed into the states of their group
+static void AddFileStatusCommands(const TArray<FString>& InFiles, FPlasticStatusGroup& InOutGroup, FString& InOutFilename, TArray<FPlasticPipelinedCommand>& OutCommands)
+{
+	TArray<FString> Status;
+	Status.Add(TEXT("--nostatus"));
+	Status.Add(TEXT("--noheaders"));
+	Status.Add(TEXT("--all"));
+	Status.Add(TEXT("--ignored"));
+	Status.Add(TEXT("--fullpaths"));
+	for (const FString& File : InFiles)
+	{
+		TArray<FString> OneFile;
+		OneFile.Add(File);
+		OutCommands.Add(FPlasticPipelinedCommand(TEXT("status"), Status, OneFile));
+		OutCommands.Last().LineCallback = [&InOutGroup, &InOutFilename](const FString& InLine)
+		{
+			ParseStatusResult(InLine, false, InOutGroup, InOutFilename);
+		};
+	}
 }
 
-void GetPlasticScmVersion(FString& OutPlasticScmVersion)
+// Run a "fileinfo" command on a chunk of the files of a directory, preceded by the "status" of its files: for a large directory, one "status"
+// on the whole directory run by its first chunk, else one "status" per file, all sent back to back to the same 'cm shell' to save round trips.
+// The lines of both are merged into the states of the group as they are streamed: the status only writes the workspace state of the files,
+// and the fileinfo of each chunk only the revisions and locks of its own files, so the chunks of a group never write the same fields.
+static void RunStatusAndFileinfo(FPlasticStatusGroup& InOutGroup, FPlasticFileinfoChunk& InOutChunk)
 {
-	TArray<FString> InfoMessages;
-	TArray<FString> ErrorMessages;
-	const bool bResult = RunCommand(TEXT("version"), TArray<FString>(), TArray<FString>(), InfoMessages, ErrorMessages);
-	if (bResult && InfoMessages.Num() > 0)
+	// filenames of the lines, reused from one line to the next
+	FString StatusFilename;
+	FString FileinfoFilename;
+	TArray<FPlasticPipelinedCommand> Commands;
+	if (InOutChunk.bWithDirectoryStatus)
 	{
-		OutPlasticScmVersion = InfoMessages[0];
+		TArray<FString> Status;
+		Status.Add(TEXT("--nostatus"));
+		Status.Add(TEXT("--noheaders"));
+		Status.Add(TEXT("--all"));
+		Status.Add(TEXT("--ignored"));
+		Status.Add(TEXT("--fullpaths"));
+		// The "status" command only operates on one path, so run it on the directory of the group (see RunUpdateStatus)
+		// which lists the changes of the whole directory at once, instead of one "status" per file
+		TArray<FString> Directory;
+		Directory.Add(InOutGroup.Directory);
+		Commands.Add(FPlasticPipelinedCommand(TEXT("status"), Status, Directory));
+		Commands.Last().LineCallback = [&InOutGroup, &StatusFilename](const FString& InLine)
+		{
+			ParseStatusResult(InLine, true, InOutGroup, StatusFilename);
+		};
 	}
-}
-
-void GetUserName(FString& OutUserName)
-{
-	TArray<FString> InfoMessages;
-	TArray<FString> ErrorMessages;
-	const bool bResult = RunCommand(TEXT("whoami"), TArray<FString>(), TArray<FString>(), InfoMessages, ErrorMessages);
-	if (bResult && InfoMessages.Num() > 0)
+	else if (!InOutGroup.bDirectoryStatus)
 	{
-		OutUserName = InfoMessages[0];
+		AddFileStatusCommands(InOutChunk.Files, InOutGroup, StatusFilename, Commands);
 	}
-}
 
-bool GetWorkspaceName(const FString& InWorkspaceRoot, FString& OutWorkspaceName)
-{
-	TArray<FString> InfoMessages;
-	TArray<FString> ErrorMessages;
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("--format={0}"));
-	TArray<FString> Files;
-	Files.Add(InWorkspaceRoot);
-	// Get the workspace name
-	const bool bResult = RunCommand(TEXT("getworkspacefrompath"), Parameters, Files, InfoMessages, ErrorMessages);
-	if (bResult && InfoMessages.Num() > 0)
+	// Plastic "fileinfo" (similar to "status") command to update status of all the files of the chunk
+	TArray<FString> Fileinfo;
+	Fileinfo.Add(TEXT("--format=\"{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere};{ClientPath}\""));
+	Commands.Add(FPlasticPipelinedCommand(TEXT("fileinfo"), Fileinfo, InOutChunk.Files));
+	Commands.Last().LineCallback = [&InOutGroup, &FileinfoFilename](const FString& InLine)
 	{
-		OutWorkspaceName = MoveTemp(InfoMessages[0]);
-	}
+		ParseFileinfoResult(InLine, InOutGroup, FileinfoFilename);
+	};
 
-	return bResult;
+	PlasticSourceControlUtils::RunCommands(Commands);
+
+	for (int32 Index = 0; Index < Commands.Num() - 1; Index++)
+	{
+		FPlasticPipelinedCommand& StatusCommand = Commands[Index];
+		InOutChunk.bStatusResult &= StatusCommand.bResult;
+		InOutChunk.StatusErrorMessages.Append(MoveTemp(StatusCommand.ErrorMessages));
+	}
+	FPlasticPipelinedCommand& FileinfoCommand = Commands.Last();
+	InOutChunk.bResult = FileinfoCommand.bResult;
+	InOutChunk.ErrorMessages = MoveTemp(FileinfoCommand.ErrorMessages);
 }
 
-bool GetRepositorySpecification(const FString& InWorkspaceRoot, FString& OutRepositoryName, FString& OutServerUrl) 
+// Run a Plastic "status" and "fileinfo" commands to update status of given files.
+bool RunUpdateStatus(const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
 {
-	TArray<FString> InfoMessages;
-	TArray<FString> ErrorMessages;
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("--nochanges"));
-	TArray<FString> Files;
-	Files.Add(InWorkspaceRoot);
-	// Get the workspace status, looking like "cs:41@rep:UE4PlasticPlugin@repserver:localhost:8087"
-	bool bResult = RunCommand(TEXT("status"), Parameters, Files, InfoMessages, ErrorMessages);
-	if (bResult && InfoMessages.Num() > 0)
+	bool bResult = true;
+
+	// Plastic fileinfo does not return any results when called with at least one file not in a workspace,
+	// and Plastic status only operates on one path at a time (a file, or a whole directory)
+	// 1) So here we group files by path (ie. by subdirectory)
+	TMap<FString, int32> GroupIndexes;
+	TArray<FPlasticStatusGroup> Groups;
+	for (const FString& File : InFiles)
 	{
-		static const FString Changeset(TEXT("cs:"));
-		static const FString Rep(TEXT("rep:"));
-		static const FString Server(TEXT("repserver:"));
-		const FString& WorkspaceStatus = InfoMessages[0];
-		TArray<FString> RepositorySpecification;
- 		WorkspaceStatus.ParseIntoArray(RepositorySpecification, TEXT("@"));
-		if (3 >= RepositorySpecification.Num())
+		FString Path = FPaths::GetPath(*File);
+		const int32* GroupIndex = GroupIndexes.Find(Path);
+		if (GroupIndex != nullptr)
 		{
-//			OutChangeset = RepositorySpecification[0].RightChop(Changeset.Len());
-			OutRepositoryName = RepositorySpecification[1].RightChop(Rep.Len());
-			OutServerUrl = RepositorySpecification[2].RightChop(Server.Len());
+			Groups[*GroupIndex].Files.Add(File);
 		}
 		else
 		{
-			bResult = false;
+			GroupIndexes.Add(Path, Groups.Num());
+			FPlasticStatusGroup& Group = Groups[Groups.AddDefaulted()];
+			Group.Files.Add(File);
+			Group.Directory = MoveTemp(Path);
+			Group.bDirectoryStatus = false;
+			Group.bSkipped = false;
+			Group.InheritedState = EWorkspaceState::Unknown;
+			Group.bStatusResult = true;
 		}
 	}
 
-	return bResult;
-}
-
-void GetBranchName(const FString& InWorkspaceRoot, FString& OutBranchName)
-{
-	TArray<FString> InfoMessages;
-	TArray<FString> ErrorMessages;
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("--wkconfig"));
-	Parameters.Add(TEXT("--nochanges"));
-	Parameters.Add(TEXT("--nostatus"));
-	TArray<FString> Files;
-	Files.Add(InWorkspaceRoot);
-	const bool bResult = RunCommand(TEXT("status"), Parameters, Files, InfoMessages, ErrorMessages);
-	if(bResult && InfoMessages.Num() > 0)
+	// 2) then we can batch Plastic status by subdirectory, one for the whole subdirectory if large enough, and split only the fileinfo of large ones into chunks
+	TArray<FPlasticFileinfoChunk> Chunks;
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
 	{
-		OutBranchName = InfoMessages[0];
+		FPlasticStatusGroup& Group = Groups[GroupIndex];
+		if (1 == Group.Files.Num() && !FPaths::FileExists(Group.Files[0]))
+		{
+			// Special case for "status" of a non-existing file (newly created/deleted): no need to query it (see below)
+			Group.bSkipped = true;
+			continue;
+		}
+		Group.bDirectoryStatus = (Group.Files.Num() >= PlasticSourceControlConstants::MinDirectoryStatusFiles);
+		// States of the files of this group only, Unknown until a status line is about them (see step 4)
+		Group.States.Reserve(Group.Files.Num());
+		for (const FString& File : Group.Files)
+		{
+			Group.IndexOfFiles.Add(File, Group.States.Num());
+			Group.States.Add(FPlasticSourceControlState(File));
+		}
+		TArray<TArray<FString>> GroupChunks;
+		SplitFilesIntoChunks(Group.Files, GroupChunks);
+		for (int32 ChunkIndex = 0; ChunkIndex < GroupChunks.Num(); ChunkIndex++)
+		{
+			FPlasticFileinfoChunk& Chunk = Chunks[Chunks.AddDefaulted()];
+			Chunk.GroupIndex = GroupIndex;
+			Chunk.bWithDirectoryStatus = Group.bDirectoryStatus && (ChunkIndex == 0);
+			Chunk.Files = MoveTemp(GroupChunks[ChunkIndex]);
+			Chunk.bStatusResult = true;
+			Chunk.bResult = false;
+		}
 	}
-}
 
-/**
- * Extract and interpret the file state from the given Plastic "status" result.
- * empty string = unmodified/controlled or hidden changes
- CH Content\Changed_BP.uasset
- CO Content\CheckedOut_BP.uasset
- CP Content\Copied_BP.uasset
- RP Content\Replaced_BP.uasset
- AD Content\Added_BP.uasset
- PR Content\Private_BP.uasset
- IG Content\Ignored_BP.uasset
- DE Content\Deleted_BP.uasset
- LD Content\Deleted2_BP.uasset
- MV 100% Content\ToMove_BP.uasset -> Content\Moved_BP.uasset
- LM 100% Content\ToMove2_BP.uasset -> Content\Moved2_BP.uasset
-
- TODO: Conflicted files?
-*/
-class FPlasticStatusParser
-{
-public:
-	FPlasticStatusParser(const FString& InResult)
+	// 3) and run them concurrently on the pool of 'cm shell'
+	const volatile int32* CancelFlag = FScopedPlasticCancellation::GetCancelFlag();
+	const EPlasticCommandPriority::Type Priority = FScopedPlasticCommandPriority::GetPriority();
+	RunChunksConcurrently(Chunks.Num(), GetMaxLeasedShells(), [&](int32 Index)
 	{
-		const FString FileStatus = InResult.Mid(1, 2);
-
-		if (FileStatus == "CH") // Modified but not Checked-Out
+		FScopedPlasticCancellation Cancellation(CancelFlag);
+		FScopedPlasticCommandPriority CommandPriority(Priority);
+		YieldToInteractiveCommands();
+		RunStatusAndFileinfo(Groups[Chunks[Index].GroupIndex], Chunks[Index]);
+	});
+
+	// 4) before merging the results of each subdirectory, in order
+	TArray<TPair<int32, int32>> UnresolvedFiles;
+	int32 ChunkIndex = 0;
+	for (int32 GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+	{
+		FPlasticStatusGroup& Group = Groups[GroupIndex];
+		if (Group.bSkipped)
 		{
-			State = EWorkspaceState::Changed;
+			continue;
 		}
-		else if (FileStatus == "CO") // Checked-Out for modification
+
+		// Do not use fileinfo results if the status failed (useful for global "submit to source control")
+		const int32 FirstChunkIndex = ChunkIndex;
+		for (; (ChunkIndex < Chunks.Num()) && (Chunks[ChunkIndex].GroupIndex == GroupIndex); ChunkIndex++)
 		{
-			State = EWorkspaceState::CheckedOut;
+			OutErrorMessages.Append(Chunks[ChunkIndex].StatusErrorMessages);
+			Group.bStatusResult &= Chunks[ChunkIndex].bStatusResult;
 		}
-		else if (FileStatus == "CP")
+		bResult &= Group.bStatusResult;
+		if (!Group.bStatusResult)
 		{
-			State = EWorkspaceState::Copied;
+			continue;
 		}
-		else if (FileStatus == "RP")
+		for (int32 Index = FirstChunkIndex; Index < ChunkIndex; Index++)
 		{
-			State = EWorkspaceState::Replaced;
+			OutErrorMessages.Append(Chunks[Index].ErrorMessages);
+			bResult &= Chunks[Index].bResult;
 		}
-		else if (FileStatus == "AD")
+
+		// the files without any status line of their own are in a private or ignored folder, or else unchanged,
+		// unless fileinfo does not know about them either (in a private folder not reported by the status of the directory)
+		for (int32 StateIndex = 0; StateIndex < Group.States.Num(); StateIndex++)
 		{
-			State = EWorkspaceState::Added;
+			FPlasticSourceControlState& FileState = Group.States[StateIndex];
+			if (FileState.WorkspaceState == EWorkspaceState::Unknown)
+			{
+				if (Group.InheritedState != EWorkspaceState::Unknown)
+				{
+					FileState.WorkspaceState = Group.InheritedState;
+				}
+				else if ((FileState.LocalRevisionChangeset == -1) && Group.bDirectoryStatus)
+				{
+					UnresolvedFiles.Add(TPairInitializer<int32, int32>(GroupIndex, StateIndex));
+				}
+				else
+				{
+					FileState.WorkspaceState = EWorkspaceState::Controlled;
+				}
+			}
 		}
-		else if (FileStatus == "PR") // Not Controlled/Not in Depot/Untracked
+	}
+
+	// 5) query individually the files left without any result at all
+	if (UnresolvedFiles.Num() > 0)
+	{
+		UE_LOG(LogSourceControl, Verbose, TEXT("RunUpdateStatus: %d files without any result, queried individually"), UnresolvedFiles.Num());
+		const int32 NbBatches = FMath::DivideAndRoundUp(UnresolvedFiles.Num(), PlasticSourceControlConstants::MinChunkFiles);
+		TArray<bool> BatchResults;
+		BatchResults.Init(false, NbBatches);
+		TArray<TArray<FString>> BatchErrorMessages;
+		BatchErrorMessages.SetNum(NbBatches);
+		RunChunksConcurrently(NbBatches, GetMaxLeasedShells(), [&](int32 BatchIndex)
 		{
-			State = EWorkspaceState::Private;
-		}
-		else if (FileStatus == "IG")
+			FScopedPlasticCancellation Cancellation(CancelFlag);
+			FScopedPlasticCommandPriority CommandPriority(Priority);
+			YieldToInteractiveCommands();
+			FString StatusFilename;
+			TArray<FPlasticPipelinedCommand> Commands;
+			const int32 LastIndex = FMath::Min(UnresolvedFiles.Num(), (BatchIndex + 1) * PlasticSourceControlConstants::MinChunkFiles);
+			for (int32 Index = BatchIndex * PlasticSourceControlConstants::MinChunkFiles; Index < LastIndex; Index++)
+			{
+				FPlasticStatusGroup& Group = Groups[UnresolvedFiles[Index].Key];
+				TArray<FString> OneFile;
+				OneFile.Add(Group.States[UnresolvedFiles[Index].Value].LocalFilename);
+				AddFileStatusCommands(OneFile, Group, StatusFilename, Commands);
+			}
+			BatchResults[BatchIndex] = PlasticSourceControlUtils::RunCommands(Commands);
+			for (FPlasticPipelinedCommand& Command : Commands)
+			{
+				BatchErrorMessages[BatchIndex].Append(MoveTemp(Command.ErrorMessages));
+			}
+		});
+		for (int32 BatchIndex = 0; BatchIndex < NbBatches; BatchIndex++)
 		{
-			State = EWorkspaceState::Ignored;
+			bResult &= BatchResults[BatchIndex];
+			OutErrorMessages.Append(BatchErrorMessages[BatchIndex]);
 		}
-		else if ((FileStatus == "DE") || (FileStatus == "LD")) // TODO: need to differentiate for CanEdit/CanCheckout/CanCheckIn?
+		for (const TPair<int32, int32>& UnresolvedFile : UnresolvedFiles)
 		{
-			State = EWorkspaceState::Deleted; // Deleted or Locally Deleted (ie. missing)
+			FPlasticSourceControlState& FileState = Groups[UnresolvedFile.Key].States[UnresolvedFile.Value];
+			if (FileState.WorkspaceState == EWorkspaceState::Unknown)
+			{
+				FileState.WorkspaceState = EWorkspaceState::Controlled;
+			}
 		}
-		else if ((FileStatus == "MV") || (FileStatus == "LM")) // Renamed TODO: need to differentiate for CanEdit/CanCheckout/CanCheckIn?
+	}
+
+	// 6) and returning them in the order of the subdirectories
+	for (FPlasticStatusGroup& Group : Groups)
+	{
+		if (Group.bSkipped)
 		{
-			State = EWorkspaceState::Moved; // Moved/Renamed or Locally Moved
+			OutStates.Add(FPlasticSourceControlState(Group.Files[0]));
+			OutStates.Last().WorkspaceState = EWorkspaceState::Private; // Not Controlled
 		}
-		else if (FileStatus == "conflited") // TODO: what is the appropriate status?
+		else if (Group.bStatusResult)
 		{
-			State = EWorkspaceState::Conflicted;
+			// both results are merged by filename, so the fileinfo of the chunks that succeeded can still be used
+			FinalizeStatusAndFileinfoStates(Group.States);
+			// TODO In case of a conflict (unmerged file) get the base revision to merge
+			OutStates.Append(MoveTemp(Group.States));
 		}
 		else
 		{
-			UE_LOG(LogSourceControl, Warning, TEXT("Unknown"));
-			State = EWorkspaceState::Unknown;
+			// discard what has been merged from the results streamed before the failure
+			for (const FString& File : Group.Files)
+			{
+				OutStates.Add(FPlasticSourceControlState(File));
+			}
 		}
 	}
 
-	EWorkspaceState::Type State;
-};
+	return bResult;
+}
 
-/** Parse the array of strings results of a 'cm status --nostatus --noheaders --all --ignore' command
- *
- * Example cm status results:
- CH Content\Changed_BP.uasset
- CO Content\CheckedOut_BP.uasset
- CP Content\Copied_BP.uasset
- RP Content\Replaced_BP.uasset
- AD Content\Added_BP.uasset
- PR Content\Private_BP.uasset
- IG Content\Ignored_BP.uasset
- DE Content\Deleted_BP.uasset
- LD Content\Deleted2_BP.uasset
- MV 100% Content\ToMove_BP.uasset -> Content\Moved_BP.uasset
- LM 100% Content\ToMove2_BP.uasset -> Content\Moved2_BP.uasset
- */
-static void ParseStatusResult(const FString& InFile, const TArray<FString>& InResults, FPlasticSourceControlState& OutFileState)
+// Run a single recursive Plastic "status" command over a whole subtree of the workspace, to get the state of all its changed, private and ignored files
+bool RunWorkspaceStatus(const FString& InSubtree, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
 {
-	// Assuming one line of results for one file.
-	static const FString EmptyString(TEXT(""));
-	if (0 < InResults.Num())
+	TArray<FString> Parameters;
+	Parameters.Add(TEXT("--nostatus"));
+	Parameters.Add(TEXT("--noheaders"));
+	Parameters.Add(TEXT("--all"));
+	Parameters.Add(TEXT("--private"));
+	Parameters.Add(TEXT("--ignored"));
+	Parameters.Add(TEXT("--fullpaths"));
+	TArray<FString> Subtree;
+	Subtree.Add(InSubtree);
+	TArray<FPlasticPipelinedCommand> Commands;
+	Commands.Add(FPlasticPipelinedCommand(TEXT("status"), Parameters, Subtree));
+
+	// Contrary to the status of a directory of requested files, each line is a file (or a private directory) with changes,
+	// parsed as soon as it is received; indexed by filename so that the lines streamed again if the command is retried replace the first ones
+	const int32 FirstState = OutStates.Num();
+	TMap<FString, int32> IndexOfStates;
+	FString Filename;
+	const FDateTime Now = FDateTime::Now();
+	Commands.Last().LineCallback = [&](const FString& InLine)
+	{
+		const FPlasticStatusParser StatusParser(InLine);
+		StatusParser.GetFilename(Filename);
+		FPlasticSourceControlState* FileState;
+		const int32* Index = IndexOfStates.Find(Filename);
+		if (Index != nullptr)
+		{
+			FileState = &OutStates[*Index];
+		}
+		else
+		{
+			IndexOfStates.Add(Filename, OutStates.Num());
+			OutStates.Add(FPlasticSourceControlState(Filename));
+			FileState = &OutStates.Last();
+		}
+		FileState->WorkspaceState = StatusParser.State;
+		FileState->MovedFrom = StatusParser.GetMovedFrom();
+		FileState->TimeStamp = Now;
+	};
+	RunCommands(Commands);
+
+	FPlasticPipelinedCommand& StatusCommand = Commands.Last();
+	OutErrorMessages.Append(MoveTemp(StatusCommand.ErrorMessages));
+	if (StatusCommand.bResult)
 	{
-		const FString& Status = InResults[InResults.Num()-1]; // NOTE: in case of rename by editor, there are two results: checkouted AND renamed
-		const FPlasticStatusParser StatusParser(Status);
-		OutFileState.WorkspaceState = StatusParser.State;
+		UE_LOG(LogSourceControl, Verbose, TEXT("status of '%s': %d changes"), *InSubtree, OutStates.Num() - FirstState);
 	}
 	else
 	{
-		// No result means Controlled/Unchanged file/Hidden changes
-		OutFileState.WorkspaceState = EWorkspaceState::Controlled;
+		OutStates.SetNum(FirstState);
 	}
-	// @todo: temporary debug log
-	UE_LOG(LogSourceControl, Log, TEXT("%s = %d:%s"), *InFile, static_cast<uint32>(OutFileState.WorkspaceState), OutFileState.ToString());
-	OutFileState.TimeStamp.Now();
+	return StatusCommand.bResult;
 }
 
-// Run a "status" command for each file to get workspace states
-static bool RunStatus(const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
+// Run a recursive Plastic "ls" command to list the controlled files of a whole subtree, as loaded in the workspace (even if deleted locally)
+bool RunListControlledFiles(const FString& InSubtree, TArray<FString>& OutErrorMessages, TArray<FString>& OutFiles)
 {
-	bool bResult = true;
-
-	TArray<FString> Status;
-	Status.Add(TEXT("--nostatus"));
-	Status.Add(TEXT("--noheaders"));
-	Status.Add(TEXT("--all"));
-	Status.Add(TEXT("--ignored"));
-
-	if (1 == InFiles.Num() && !FPaths::FileExists(InFiles[0]))
-	{
-		// Special case for "status" of a non-existing file (newly created/deleted)
-		OutStates.Add(FPlasticSourceControlState(InFiles[0]));
-		FPlasticSourceControlState& FileState = OutStates.Last();
-		FileState.WorkspaceState = EWorkspaceState::Private; // Not Controlled
-		bResult = false; // false so that we do not try to get it's lock state with "fileinfo"
-	}
-	else
+	TArray<FString> Parameters;
+	Parameters.Add(TEXT("-R"));
+	Parameters.Add(TEXT("--format=\"{type};{path}\""));
+	TArray<FString> Subtree;
+	Subtree.Add(InSubtree);
+	return RunCommandStreaming(TEXT("ls"), Parameters, Subtree, [&InSubtree, &OutFiles](const FString& InLine)
 	{
-		for (const FString& File : InFiles)
+		// only the files, not the directories
+		int32 Separator;
+		if (!InLine.StartsWith(TEXT("dir;")) && InLine.FindChar(TEXT(';'), Separator))
 		{
-			// The "status" command only operate on one file at a time (TODO or one Folder!)
-			OutStates.Add(FPlasticSourceControlState(File));
-			FPlasticSourceControlState& FileState = OutStates.Last();
-
-			// Do not run status commands anymore after the first failure (optimization, useful for global "submit to source control")
-			if (bResult)
+			FString File = InLine.Mid(Separator + 1);
+			if (FPaths::IsRelative(File))
 			{
-				TArray<FString> OneFile;
-				OneFile.Add(File);
-				TArray<FString> Results;
-				TArray<FString> ErrorMessages;
-				bResult = RunCommand(TEXT("status"), Status, OneFile, Results, ErrorMessages);
-				OutErrorMessages.Append(ErrorMessages);
-				if (bResult)
-				{
-					ParseStatusResult(File, Results, FileState);
-					if (FileState.IsConflicted())
-					{
-						// TODO In case of a conflict (unmerged file) get the base revision to merge
-					}
-				}
+				File = InSubtree / File;
 			}
+			FPaths::NormalizeFilename(File);
+			OutFiles.Add(MoveTemp(File));
 		}
-	}
-
-	return bResult;
+	}, OutErrorMessages);
 }
 
-// Parse the fileinfo output format "{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere}"
-class FPlasticFileinfoParser
+// Run a single status of the whole workspace, and then a "fileinfo" of its controlled files only, to prefetch the state of all its files
+bool RunWorkspacePrefetch(const FString& InWorkspaceRoot, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
 {
-public:
-	FPlasticFileinfoParser(const FString& InResult)
+	// 1) The files with changes, and the private and ignored ones (a private or ignored folder being reported as a single line)
+	TArray<FPlasticSourceControlState> StatusStates;
+	if (!RunWorkspaceStatus(InWorkspaceRoot, OutErrorMessages, StatusStates))
 	{
-		TArray<FString> Fileinfos;
-		const int32 NbElmts = InResult.ParseIntoArray(Fileinfos, TEXT(";"));
-		if (NbElmts >= 2)
-		{
-			RevisionChangeset = FCString::Atoi(*Fileinfos[0]);
-			RevisionHeadChangeset = FCString::Atoi(*Fileinfos[1]);
-			if (NbElmts >= 3)
-			{
-				LockedBy = MoveTemp(Fileinfos[2]);
-				if (NbElmts >=4)
-				{
-					LockedWhere = MoveTemp(Fileinfos[3]);
-				}
-			}
-		}
+		return false;
 	}
 
-	int32 RevisionChangeset;
-	int32 RevisionHeadChangeset;
-	FString LockedBy;
-	FString LockedWhere;
-};
-
-/** Parse the array of strings results of a 'cm fileinfo --format="{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere}"' command
- *
- * Example cm fileinfo results:
-16;16;;
-14;15;;
-17;17;srombauts;Workspace_2
-*/
-static void ParseFileinfoResults(const TArray<FString>& InFiles, const TArray<FString>& InResults, TArray<FPlasticSourceControlState>& InOutStates)
-{
-	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>("PlasticSourceControl");
-	FPlasticSourceControlProvider& Provider = PlasticSourceControl.GetProvider();
-
-	// Iterate on all files and all status of the result (assuming no more line of results than number of files)
-	for (int32 IdxResult = 0; IdxResult < InResults.Num(); IdxResult++)
+	// 2) and the controlled files, asked to cm instead of enumerating the files on disk (build outputs and other private trees)
+	TArray<FString> ControlledFiles;
+	if (!RunListControlledFiles(InWorkspaceRoot, OutErrorMessages, ControlledFiles))
 	{
-		const FString& File = InFiles[IdxResult];
-		const FString& Fileinfo = InResults[IdxResult];
-		FPlasticSourceControlState& FileState = InOutStates[IdxResult];
-		FPlasticFileinfoParser FileinfoParser(Fileinfo);
-
-		FileState.LocalRevisionChangeset = FileinfoParser.RevisionChangeset;
-		FileState.DepotRevisionChangeset = FileinfoParser.RevisionHeadChangeset;
-		FileState.LockedBy = MoveTemp(FileinfoParser.LockedBy);
-		FileState.LockedWhere = MoveTemp(FileinfoParser.LockedWhere);
+		return false;
+	}
 
-		if ((0 < FileState.LockedBy.Len()) && ((FileState.LockedBy != Provider.GetUserName()) || (FileState.LockedWhere != Provider.GetWorkspaceName())))
+	// 3) are merged into the states of the controlled files, Controlled unless reported by the status
+	TMap<FString, int32> IndexOfStatus;
+	IndexOfStatus.Reserve(StatusStates.Num());
+	TSet<FString> MovedFromFiles;
+	for (int32 Index = 0; Index < StatusStates.Num(); Index++)
+	{
+		IndexOfStatus.Add(StatusStates[Index].LocalFilename, Index);
+		if (!StatusStates[Index].MovedFrom.IsEmpty())
 		{
-			// @todo: temporary debug log
-			UE_LOG(LogSourceControl, Warning, TEXT("LockedByOther(%s) by '%s!=%s' (or %s!=%s)"), *File, *FileState.LockedBy, *Provider.GetUserName(), *FileState.LockedWhere, *Provider.GetWorkspaceName());
-			FileState.WorkspaceState = EWorkspaceState::LockedByOther;
+			MovedFromFiles.Add(StatusStates[Index].MovedFrom);
 		}
-
-		// @todo: temporary debug log
-		UE_LOG(LogSourceControl, Log, TEXT("%s: %d;%d by '%s' (%s)"), *File, FileState.LocalRevisionChangeset, FileState.DepotRevisionChangeset, *FileState.LockedBy, *FileState.LockedWhere);
 	}
-}
-
-// Run a Plastic "fileinfo" (similar to "status") command to update status of given files.
-static bool RunFileinfo(const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
-{
-	TArray<FString> Results;
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("--format=\"{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere}\""));
-
-	TArray<FString> ErrorMessages;
-	const bool bResult = RunCommand(TEXT("fileinfo"), Parameters, InFiles, Results, ErrorMessages);
-	OutErrorMessages.Append(ErrorMessages);
-	if (bResult)
+	TArray<bool> ReportedStatus;
+	ReportedStatus.Init(false, StatusStates.Num());
+	FPlasticStatusGroup Workspace;
+	Workspace.Directory = InWorkspaceRoot;
+	Workspace.bDirectoryStatus = true;
+	Workspace.bSkipped = false;
+	Workspace.InheritedState = EWorkspaceState::Unknown;
+	Workspace.bStatusResult = true;
+	Workspace.States.Reserve(ControlledFiles.Num());
+	TArray<FString> FileinfoFiles;
+	FileinfoFiles.Reserve(ControlledFiles.Num());
+	for (FString& File : ControlledFiles)
 	{
-		ParseFileinfoResults(InFiles, Results, OutStates);
+		if (MovedFromFiles.Contains(File))
+		{
+			// the source of a move, not on disk anymore
+			continue;
+		}
+		Workspace.IndexOfFiles.Add(File, Workspace.States.Num());
+		const int32* StatusIndex = IndexOfStatus.Find(File);
+		if (StatusIndex != nullptr)
+		{
+			ReportedStatus[*StatusIndex] = true;
+			Workspace.States.Add(StatusStates[*StatusIndex]);
+		}
+		else
+		{
+			Workspace.States.Add(FPlasticSourceControlState(File));
+			Workspace.States.Last().WorkspaceState = EWorkspaceState::Controlled;
+		}
+		// no fileinfo for the files not on disk anymore
+		if (Workspace.States.Last().WorkspaceState != EWorkspaceState::Deleted)
+		{
+			FileinfoFiles.Add(MoveTemp(File));
+		}
 	}
+	ControlledFiles.Empty();
+
+	// 4) with their revisions and locks, by chunks yielding to the interactive commands
+	TArray<TArray<FString>> Chunks;
+	SplitFilesIntoChunks(FileinfoFiles, Chunks);
+	FileinfoFiles.Empty();
+	TArray<bool> ChunkResults;
+	ChunkResults.Init(false, Chunks.Num());
+	const volatile int32* CancelFlag = FScopedPlasticCancellation::GetCancelFlag();
+	const EPlasticCommandPriority::Type Priority = FScopedPlasticCommandPriority::GetPriority();
+	RunChunksConcurrently(Chunks.Num(), GetMaxLeasedShells(), [&](int32 Index)
+	{
+		FScopedPlasticCancellation Cancellation(CancelFlag);
+		FScopedPlasticCommandPriority CommandPriority(Priority);
+		YieldToInteractiveCommands();
+		FString FileinfoFilename;
+		TArray<FString> Fileinfo;
+		Fileinfo.Add(TEXT("--format=\"{RevisionChangeset};{RevisionHeadChangeset};{LockedBy};{LockedWhere};{ClientPath}\""));
+		TArray<FPlasticPipelinedCommand> Commands;
+		Commands.Add(FPlasticPipelinedCommand(TEXT("fileinfo"), Fileinfo, Chunks[Index]));
+		Commands.Last().LineCallback = [&Workspace, &FileinfoFilename](const FString& InLine)
+		{
+			ParseFileinfoResult(InLine, Workspace, FileinfoFilename);
+		};
+		ChunkResults[Index] = RunCommands(Commands);
+		if (!ChunkResults[Index])
+		{
+			// not worth failing the whole prefetch: the Editor asks for the states it needs anyway
+			UE_LOG(LogSourceControl, Log, TEXT("Prefetch: fileinfo of %d files failed: %s"), Chunks[Index].Num(), (Commands.Last().ErrorMessages.Num() > 0) ? *Commands.Last().ErrorMessages[0] : TEXT(""));
+		}
+	});
 
-	return bResult;
-}
-
-// Run a Plastic "status" and "fileinfo" commands to update status of given files.
-bool RunUpdateStatus(const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates)
-{
-	bool bResult = true;
-
-	// Plastic fileinfo does not return any results when called with at least one file not in a workspace
-	// 1) So here we group files by path (ie. by subdirectory)
-	TMap<FString, TArray<FString>> GroupOfFiles;
-	for (const FString& File : InFiles)
+	// 5) leaving out the files of the chunks that failed, left as they are in cache
+	TArray<bool> Resolved;
+	Resolved.Init(true, Workspace.States.Num());
+	for (int32 Index = 0; Index < Chunks.Num(); Index++)
 	{
-		const FString Path = FPaths::GetPath(*File);
-		TArray<FString>* Group = GroupOfFiles.Find(Path);
-		if (Group != nullptr)
+		if (!ChunkResults[Index])
 		{
-			Group->Add(File);
+			for (const FString& File : Chunks[Index])
+			{
+				Resolved[Workspace.IndexOfFiles.FindChecked(File)] = false;
+			}
 		}
-		else
+	}
+	FinalizeStatusAndFileinfoStates(Workspace.States);
+	OutStates.Reserve(OutStates.Num() + Workspace.States.Num() + StatusStates.Num());
+	for (int32 Index = 0; Index < Workspace.States.Num(); Index++)
+	{
+		if (Resolved[Index])
 		{
-			TArray<FString> NewGroup;
-			NewGroup.Add(File);
-			GroupOfFiles.Add(Path, NewGroup);
+			OutStates.Add(MoveTemp(Workspace.States[Index]));
 		}
 	}
-
-	// 2) then we can batch Plastic status operation by subdirectory
-	for (const auto& Files : GroupOfFiles)
+	// along with the private and ignored files (and the other ones reported by the status without being listed as controlled)
+	for (int32 Index = 0; Index < StatusStates.Num(); Index++)
 	{
-		// Run a "status" command for each file to get workspace states
-		const bool bGroupOk = RunStatus(Files.Value, OutErrorMessages, OutStates);
-		if (bGroupOk)
+		if (!ReportedStatus[Index])
 		{
-			// Run a Plastic "fileinfo" (similar to "status") command to update status of given files.
-			bResult &= RunFileinfo(Files.Value, OutErrorMessages, OutStates);
+			OutStates.Add(MoveTemp(StatusStates[Index]));
 		}
 	}
+	UE_LOG(LogSourceControl, Log, TEXT("Prefetch of '%s': %d states (%d changes)"), *InWorkspaceRoot, OutStates.Num(), StatusStates.Num());
 
-	return bResult;
+	return true;
 }
 
 // Run a Plastic "cat" command to dump the binary content of a revision into a file.
@@ -893,63 +1922,60 @@ static bool RunLogCommand(const FString& InChangeset, FPlasticSourceControlRevis
 }
 
 /**
- * Parse results of the 'cm history --format="{1};{6}"' command, then run "cm log" on each
+ * Parse one line of results of the 'cm history --format="{1};{6}"' command
  * 
  * Results of the history command are with one changeset number and revision id by line, like that:
 14;176
 17;220
 18;223
 */
-static bool ParseHistoryResults(const TArray<FString>& InResults, TPlasticSourceControlHistory& OutHistory)
+static bool ParseHistoryResult(const FString& InResult, TArray<TSharedRef<FPlasticSourceControlRevision, ESPMode::ThreadSafe>>& OutRevisions)
 {
-	bool bResult = true;
-
-	OutHistory.Reserve(InResults.Num());
-
-	// parse history in reverse: needed to get most recent at the top (implied by the UI)
-	for (int32 Index = InResults.Num() - 1; Index >= 0; Index--)
+	int32 SeparatorIndex;
+	if (InResult.FindChar(TEXT(';'), SeparatorIndex) && (SeparatorIndex > 0) && (SeparatorIndex < InResult.Len() - 1))
 	{
-		const FString& Result = InResults[Index];
-		if (bResult)
-		{
-			TArray<FString> Infos;
-			const int32 NbElmts = Result.ParseIntoArray(Infos, TEXT(";"));
-			if (NbElmts == 2)
-			{
-				const TSharedRef<FPlasticSourceControlRevision, ESPMode::ThreadSafe> SourceControlRevision = MakeShareable(new FPlasticSourceControlRevision);
-				const FString& Changeset = Infos[0];
-				const FString& RevisionId = Infos[1];
-				SourceControlRevision->ChangesetNumber = FCString::Atoi(*Changeset);
-				SourceControlRevision->RevisionNumber = FCString::Atoi(*RevisionId);
-				SourceControlRevision->Revision = RevisionId;
-
-				// Run "cm log" on the changeset number
-				bResult = RunLogCommand(Changeset, *SourceControlRevision);
-				OutHistory.Add(SourceControlRevision);
-			}
-			else
-			{
-				bResult = false;
-			}
-		}
+		const TSharedRef<FPlasticSourceControlRevision, ESPMode::ThreadSafe> SourceControlRevision = MakeShareable(new FPlasticSourceControlRevision);
+		const FString RevisionId = InResult.RightChop(SeparatorIndex + 1);
+		SourceControlRevision->ChangesetNumber = FCString::Atoi(*InResult); // Atoi() stops at the ';' separator
+		SourceControlRevision->RevisionNumber = FCString::Atoi(*RevisionId);
+		SourceControlRevision->Revision = RevisionId;
+		OutRevisions.Add(SourceControlRevision);
+		return true;
 	}
 
-	return bResult;
+	return false;
 }
 
 // Run a Plastic "history" command and multiple "log" commands and parse them.
 bool RunGetHistory(const FString& InFile, TArray<FString>& OutErrorMessages, TPlasticSourceControlHistory& OutHistory)
 {
-	TArray<FString> Results;
 	TArray<FString> Parameters;
 	Parameters.Add(TEXT("--format=\"{1};{6}\"")); // Get Changeset number and revision Id of each revision of the asset
 	TArray<FString> OneFile;
 	OneFile.Add(*InFile);
 
-	bool bResult = RunCommand(TEXT("history"), Parameters, OneFile, Results, OutErrorMessages);
+	// Parse the history line by line as it is received, without buffering the whole output
+	TArray<TSharedRef<FPlasticSourceControlRevision, ESPMode::ThreadSafe>> Revisions;
+	bool bParsingOk = true;
+	bool bResult = RunCommandStreaming(TEXT("history"), Parameters, OneFile, [&Revisions, &bParsingOk](const FString& InLine)
+	{
+		bParsingOk &= ParseHistoryResult(InLine, Revisions);
+	}, OutErrorMessages);
 	if (bResult)
 	{
-		bResult = ParseHistoryResults(Results, OutHistory);
+		bResult = bParsingOk;
+
+		OutHistory.Reserve(Revisions.Num());
+
+		// parse history in reverse: needed to get most recent at the top (implied by the UI)
+		for (int32 Index = Revisions.Num() - 1; (Index >= 0) && bResult; Index--)
+		{
+			const TSharedRef<FPlasticSourceControlRevision, ESPMode::ThreadSafe>& SourceControlRevision = Revisions[Index];
+
+			// Run "cm log" on the changeset number
+			bResult = RunLogCommand(FString::FromInt(SourceControlRevision->ChangesetNumber), *SourceControlRevision);
+			OutHistory.Add(SourceControlRevision);
+		}
 	}
 
 	return bResult;
@@ -964,10 +1990,18 @@ bool UpdateCachedStates(const TArray<FPlasticSourceControlState>& InStates)
 	for (const auto& InState : InStates)
 	{
 		TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> State = Provider.GetStateInternal(InState.LocalFilename);
-		if (State->WorkspaceState != InState.WorkspaceState)
+		if ((State->WorkspaceState != InState.WorkspaceState) || (State->MovedFrom != InState.MovedFrom)
+			|| (State->LocalRevisionChangeset != InState.LocalRevisionChangeset) || (State->DepotRevisionChangeset != InState.DepotRevisionChangeset)
+			|| (State->LockedBy != InState.LockedBy) || (State->LockedWhere != InState.LockedWhere))
 		{
 			State->WorkspaceState = InState.WorkspaceState;
 			State->PendingMergeBaseFileHash = InState.PendingMergeBaseFileHash;
+			// revisions and locks are also part of the state persisted in the cache snapshot at shutdown
+			State->LocalRevisionChangeset = InState.LocalRevisionChangeset;
+			State->DepotRevisionChangeset = InState.DepotRevisionChangeset;
+			State->LockedBy = InState.LockedBy;
+			State->LockedWhere = InState.LockedWhere;
+			State->MovedFrom = InState.MovedFrom;
 			State->TimeStamp = InState.TimeStamp; // TODO: Bug report: Workaround a bug with the Source Control Module not updating file state after a "Save"
 			NbStatesUpdated++;
 		}
@@ -976,6 +2010,58 @@ bool UpdateCachedStates(const TArray<FPlasticSourceControlState>& InStates)
 	return (NbStatesUpdated > 0);
 }
 
+/** Is the workspace state the one of a controlled file with a pending change (without logging, contrary to FPlasticSourceControlState::IsModified()) */
+static bool IsPendingChangeWorkspaceState(const EWorkspaceState::Type InWorkspaceState)
+{
+	return (InWorkspaceState == EWorkspaceState::CheckedOut)
+		|| (InWorkspaceState == EWorkspaceState::Added)
+		|| (InWorkspaceState == EWorkspaceState::Moved)
+		|| (InWorkspaceState == EWorkspaceState::Copied)
+		|| (InWorkspaceState == EWorkspaceState::Replaced)
+		|| (InWorkspaceState == EWorkspaceState::Deleted)
+		|| (InWorkspaceState == EWorkspaceState::Changed)
+		|| (InWorkspaceState == EWorkspaceState::Conflicted);
+}
+
+bool UpdateCachedWorkspaceStates(const FString& InSubtree, const TArray<FPlasticSourceControlState>& InStates)
+{
+	FPlasticSourceControlModule& PlasticSourceControl = FModuleManager::LoadModuleChecked<FPlasticSourceControlModule>( "PlasticSourceControl" );
+	FPlasticSourceControlProvider& Provider = PlasticSourceControl.GetProvider();
+	int NbStatesUpdated = 0;
+
+	// Only the workspace states are known, revisions and locks being left as they are
+	TSet<FString> ReportedFiles;
+	ReportedFiles.Reserve(InStates.Num());
+	for (const auto& InState : InStates)
+	{
+		ReportedFiles.Add(InState.LocalFilename);
+		TSharedRef<FPlasticSourceControlState, ESPMode::ThreadSafe> State = Provider.GetStateInternal(InState.LocalFilename);
+		if ((State->WorkspaceState != InState.WorkspaceState) || (State->MovedFrom != InState.MovedFrom))
+		{
+			State->WorkspaceState = InState.WorkspaceState;
+			State->MovedFrom = InState.MovedFrom;
+			State->TimeStamp = InState.TimeStamp;
+			NbStatesUpdated++;
+		}
+	}
+
+	// All the other files of the subtree known by the cache with some pending change are now Controlled without any change (checked in or undone),
+	// the status listing private and ignored files too. Files not known to be controlled are left as they are (unknown, private, locked by someone else)
+	// and so are files not on disk anymore (deleted, then checked in).
+	for (const auto& State : Provider.GetCachedStatesUnder(InSubtree))
+	{
+		if (IsPendingChangeWorkspaceState(State->WorkspaceState) && !ReportedFiles.Contains(State->LocalFilename) && FPaths::FileExists(State->LocalFilename))
+		{
+			State->WorkspaceState = EWorkspaceState::Controlled;
+			State->MovedFrom.Empty();
+			State->TimeStamp = FDateTime::Now();
+			NbStatesUpdated++;
+		}
+	}
+
+	return (NbStatesUpdated > 0);
+}
+
 /**
  * Helper struct for RemoveRedundantErrors()
  */
@@ -4,6 +4,7 @@
 
 #include "PlasticSourceControlState.h"
 #include "PlasticSourceControlRevision.h"
+#include "PlasticSourceControlCommand.h"
 
 class FPlasticSourceControlCommand;
 
@@ -28,6 +29,150 @@ private:
 	FString Filename;
 };
 
+/**
+ * Make the Plastic commands run by the current thread abort as soon as the given flag is set, for the lifetime of this object
+ */
+class FScopedPlasticCancellation
+{
+public:
+
+	/** Constructor - register the cancel flag of the operation run by the current thread */
+	explicit FScopedPlasticCancellation(const volatile int32* InCancelFlag);
+
+	/** Destructor - restore the previous cancel flag */
+	~FScopedPlasticCancellation();
+
+	/** Get the cancel flag of the operation run by the current thread, if any */
+	static const volatile int32* GetCancelFlag();
+
+private:
+	/** The cancel flag registered before this one (if any) */
+	const volatile int32* PreviousCancelFlag;
+};
+
+/**
+ * Register the priority of the operation run by the current thread, for the lifetime of this object:
+ * the Plastic commands of a background operation yield to interactive ones between their chunks,
+ * and only interactive operations can lease the last free 'cm shell' of the pool
+ */
+class FScopedPlasticCommandPriority
+{
+public:
+
+	/** Constructor - register the priority of the operation run by the current thread */
+	explicit FScopedPlasticCommandPriority(const EPlasticCommandPriority::Type InPriority);
+
+	/** Destructor - restore the previous priority */
+	~FScopedPlasticCommandPriority();
+
+	/** Get the priority of the operation run by the current thread (interactive if not run by a command of the provider) */
+	static EPlasticCommandPriority::Type GetPriority();
+
+	/** Is the operation run by the current thread a background one */
+	static bool IsBackground()
+	{
+		return (GetPriority() == EPlasticCommandPriority::Background);
+	}
+
+	/** Is the operation run by the current thread an interactive one */
+	static bool IsInteractive()
+	{
+		return (GetPriority() == EPlasticCommandPriority::Interactive);
+	}
+
+private:
+	/** The priority registered before this one */
+	EPlasticCommandPriority::Type PreviousPriority;
+};
+
+/**
+ * A Plastic command to run with RunCommands(), sent back to back with other ones to the same 'cm shell'
+ */
+struct FPlasticPipelinedCommand
+{
+	FPlasticPipelinedCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles)
+		: Command(InCommand)
+		, Parameters(InParameters)
+		, Files(InFiles)
+		, bResult(false)
+	{
+	}
+
+	/** The Plastic command - e.g. status */
+	FString Command;
+
+	/** The parameters to the Plastic command */
+	TArray<FString> Parameters;
+
+	/** The files to be operated on */
+	TArray<FString> Files;
+
+	/** true if the command succeeded and returned no errors */
+	bool bResult;
+
+	/** The results (from StdOut) as an array per-line, unless streamed to the LineCallback */
+	TArray<FString> Results;
+
+	/** Any errors (from StdErr) as an array per-line */
+	TArray<FString> ErrorMessages;
+
+	/**
+	 * If bound, called for each non-empty line of results as soon as it is received, without end of line (the string is reused for the next line),
+	 * instead of buffering the whole output before splitting it into the array of Results. Called again for each line if the command is retried.
+	 */
+	TFunction<void(const FString& InLine)> LineCallback;
+};
+
+/**
+ * Facts about the Plastic SCM installation and workspace, gathered by RunProbe() in one pipelined exchange with a 'cm shell'
+ */
+struct FPlasticProbe
+{
+	FPlasticProbe()
+		: bGetWorkspaceName(false)
+		, bGetWorkspaceStatus(false)
+		, bGetBranchName(false)
+		, bCheckConnection(false)
+		, Changeset(0)
+		, bWorkspaceStatusOk(false)
+		, bConnectionOk(false)
+	{
+	}
+
+	/** Facts to gather, on top of the version and user (memoized for the session) */
+	bool bGetWorkspaceName;
+	bool bGetWorkspaceStatus;
+	bool bGetBranchName;
+	bool bCheckConnection;
+
+	/** Version of the Plastic SCM Command Line Interface tool */
+	FString PlasticScmVersion;
+
+	/** Name of the Plastic SCM user configured globally */
+	FString UserName;
+
+	/** Name of the current workspace */
+	FString WorkspaceName;
+
+	/** Changeset, repository name and server URL of the workspace, from the workspace status */
+	int32 Changeset;
+	FString RepositoryName;
+	FString ServerUrl;
+
+	/** Name of the current branch */
+	FString BranchName;
+
+	/** Result and output of the workspace status */
+	bool bWorkspaceStatusOk;
+	TArray<FString> WorkspaceStatusMessages;
+	TArray<FString> WorkspaceStatusErrors;
+
+	/** Result and output of the check of the connection to the server */
+	bool bConnectionOk;
+	TArray<FString> ConnectionMessages;
+	TArray<FString> ConnectionErrors;
+};
+
 namespace PlasticSourceControlUtils
 {
 
@@ -37,16 +182,52 @@ namespace PlasticSourceControlUtils
 FString FindPlasticBinaryPath();
 
 /**
- * Launch the Plastic SCM "shell" command to run it in background.
+ * Launch a pool of Plastic SCM "shell" commands to run them in background.
  * @param	InPathToPlasticBinary	The path to the Plastic binary
  * @param	InWorkspaceRoot			The workspace from where to run the command - usually the Game directory
+ * @param	InPoolSize				The number of 'cm shell' processes to run concurrently
  * @returns true if the command succeeded and returned no errors
  */
-bool LaunchBackgroundPlasticShell(const FString& InPathToPlasticBinary, const FString& InWorkspaceRoot);
+bool LaunchBackgroundPlasticShell(const FString& InPathToPlasticBinary, const FString& InWorkspaceRoot, const int32 InPoolSize);
 
-/** Terminate the background 'cm shell' process and associated pipes */
+/** Terminate the background 'cm shell' processes and associated pipes */
 void Terminate();
 
+/**
+ * Does the Plastic command only read the state of the workspace, so that it can be aborted and retried safely after a timeout
+ * (as opposed to commands changing the workspace or the repository, like checkin, update or undochange)
+ */
+bool IsRetryableCommand(const FString& InCommand);
+
+/**
+ * Is the server reachable, as cached by the connection health monitor (its periodic 'checkconnection' heartbeat),
+ * instead of running a 'checkconnection' command around each command. Optimistic until the first check.
+ */
+bool IsConnectionAlive();
+
+/** Has the connection health monitor already checked the reachability of the server */
+bool HasConnectionStatus();
+
+/**
+ * Feed the connection health monitor with the result of a 'checkconnection' command run by an operation (like "Connect")
+ * @param	bInReachable		Has the server been reached
+ * @param	InLatency			Duration of the check, in seconds
+ */
+void ReportConnectionStatus(const bool bInReachable, const double InLatency);
+
+/** Ask the connection health monitor for an early check of the connection, after the failure of a command */
+void RequestConnectionCheck();
+
+/** Count an interactive command from its dispatch to its completion, for background commands to yield to it */
+void BeginInteractiveCommand();
+void EndInteractiveCommand();
+
+/**
+ * Preemption point between two chunks of a background command (no-op for other commands):
+ * wait while interactive commands are pending or running, up to a bounded delay to avoid starvation.
+ */
+void YieldToInteractiveCommands();
+
 /**
  * Find the root of the Plastic workspace, looking from the GameDir and upward in its parent directories
  * @param InPathToGameDir		The path to the Game Directory
@@ -56,17 +237,26 @@ void Terminate();
 bool FindRootDirectory(const FString& InPathToGameDir, FString& OutWorkspaceRoot);
 
 /**
- * Get Plastic SCM cli version
+ * Get Plastic SCM cli version (memoized for the session)
  * @param	OutCliVersion		Version of the Plastic SCM Command Line Interface tool
 */
 void GetPlasticScmVersion(FString& OutPlasticScmVersion);
 
 /**
- * Get Plastic SCM current user
+ * Get Plastic SCM current user (memoized for the session)
  * @param	OutUserName			Name of the Plastic SCM user configured globally
  */
 void GetUserName(FString& OutUserName);
 
+/**
+ * Gather the version, user, and the requested facts about the workspace in one pipelined exchange with a 'cm shell',
+ * instead of one round trip for each of them. The version and user are memoized for the session.
+ * @param	InWorkspaceRoot		The root of the workspace
+ * @param	InOutProbe			The facts to gather, and the facts gathered
+ * @returns true if all the commands succeeded
+ */
+bool RunProbe(const FString& InWorkspaceRoot, FPlasticProbe& InOutProbe);
+
 /**
  * Get Plastic workspace name
  * @param	InWorkspaceRoot		The workspace from where to run the command - usually the Game directory (can be empty)
@@ -82,6 +272,24 @@ bool GetWorkspaceName(const FString& InWorkspaceRoot, FString& OutWorkspaceName)
  */
 bool GetRepositorySpecification(const FString& InWorkspaceRoot, FString& OutRepositoryName, FString& OutServerUrl);
 
+/**
+ * Read the workspace name from the "plastic.workspace" metadata file of the ".plastic" subdirectory, without running any cm command
+ * @param	InWorkspaceRoot		The root of the workspace, containing the ".plastic" subdirectory
+ * @param	OutWorkspaceName	Name of the current workspace
+ * @returns true if the file has been found and parsed
+ */
+bool ReadWorkspaceName(const FString& InWorkspaceRoot, FString& OutWorkspaceName);
+
+/**
+ * Read the repository, server and branch from the "plastic.selector" metadata file of the ".plastic" subdirectory, without running any cm command
+ * @param	InWorkspaceRoot		The root of the workspace, containing the ".plastic" subdirectory
+ * @param	OutRepositoryName	Name of the repository of the current workspace
+ * @param	OutServerUrl		Url/Port of the server of the repository
+ * @param	OutBranchName		Name of the current branch, formatted like the output of "cm status --wkconfig"
+ * @returns true if the file has been found and parsed, with the server and the branch specified (else cm has to be used)
+ */
+bool ReadWorkspaceSelector(const FString& InWorkspaceRoot, FString& OutRepositoryName, FString& OutServerUrl, FString& OutBranchName);
+
 /**
  * Get Plastic current checked-out branch
  * @param	InWorkspaceRoot		The workspace from where to run the command - usually the Game directory (can be empty)
@@ -92,6 +300,9 @@ void GetBranchName(const FString& InWorkspaceRoot, FString& OutBranchName);
 /**
  * Run a Plastic command - output is a string TArray.
  *
+ * A long list of files given to a command operating on each file independently (checkout, add, remove, undochange, fileinfo)
+ * is split into chunks run concurrently on the pool of 'cm shell', their results and errors being merged back in order.
+ *
  * @param	InCommand				The Plastic command - e.g. commit
  * @param	InParameters			The parameters to the Plastic command
  * @param	InFiles					The files to be operated on
@@ -101,6 +312,28 @@ void GetBranchName(const FString& InWorkspaceRoot, FString& OutBranchName);
  */
 bool RunCommand(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TArray<FString>& OutResults, TArray<FString>& OutErrorMessages);
 
+/**
+ * Run a Plastic command, handing each line of its output to the caller as soon as it is received,
+ * instead of buffering the whole output before splitting it into an array of lines.
+ *
+ * @param	InCommand				The Plastic command - e.g. history
+ * @param	InParameters			The parameters to the Plastic command
+ * @param	InFiles					The files to be operated on
+ * @param	InLineCallback			Called for each non-empty line of results, without end of line (the string is reused for the next line)
+ * @param	OutErrorMessages		Any errors appended as an array per-line
+ * @returns true if the command succeeded and returned no errors
+ */
+bool RunCommandStreaming(const FString& InCommand, const TArray<FString>& InParameters, const TArray<FString>& InFiles, TFunctionRef<void(const FString& InLine)> InLineCallback, TArray<FString>& OutErrorMessages);
+
+/**
+ * Run several Plastic commands back to back on the same 'cm shell' (pipelining), without waiting for the result of each one,
+ * saving one round trip per command. Each command is run even if a previous one failed.
+ *
+ * @param	InOutCommands			The commands to run, in order, and their results
+ * @returns true if all the commands succeeded and returned no errors
+ */
+bool RunCommands(TArray<FPlasticPipelinedCommand>& InOutCommands);
+
 /**
  * Run a Plastic "status" command and parse it.
  *
@@ -110,6 +343,39 @@ bool RunCommand(const FString& InCommand, const TArray<FString>& InParameters, c
  */
 bool RunUpdateStatus(const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates);
 
+/**
+ * Run a single recursive Plastic "status" command over a whole subtree of the workspace, and parse it.
+ * Only the files with changes (or private, or ignored) are reported: all the other files of the subtree are Controlled.
+ *
+ * @param	InSubtree			The root of the workspace, or any directory under it
+ * @param	OutErrorMessages	Any errors (from StdErr) as an array per-line
+ * @param	OutStates			The states of the files reported by the status
+ * @returns true if the command succeeded and returned no errors
+ */
+bool RunWorkspaceStatus(const FString& InSubtree, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates);
+
+/**
+ * Run a recursive Plastic "ls" command to list the controlled files of a whole subtree of the workspace (not the private ones).
+ *
+ * @param	InSubtree			The root of the workspace, or any directory under it
+ * @param	OutErrorMessages	Any errors (from StdErr) as an array per-line
+ * @param	OutFiles			The absolute filenames of the controlled files
+ * @returns true if the command succeeded and returned no errors
+ */
+bool RunListControlledFiles(const FString& InSubtree, TArray<FString>& OutErrorMessages, TArray<FString>& OutFiles);
+
+/**
+ * Prefetch the state of all the files of the workspace: a single recursive "status" of the whole workspace (see RunWorkspaceStatus()),
+ * and then a "fileinfo" of its controlled files only (see RunListControlledFiles()), for their revisions and locks.
+ * The chunks of fileinfo that fail are only logged, their files being left out of the states.
+ *
+ * @param	InWorkspaceRoot		The root of the workspace
+ * @param	OutErrorMessages	Any errors (from StdErr) as an array per-line
+ * @param	OutStates			The states of the controlled files, and of the private and ignored ones
+ * @returns true if the status and the listing of the controlled files succeeded
+ */
+bool RunWorkspacePrefetch(const FString& InWorkspaceRoot, TArray<FString>& OutErrorMessages, TArray<FPlasticSourceControlState>& OutStates);
+
 /**
  * Run a Plastic "cat" command to dump the binary content of a revision into a file.
  *
@@ -135,6 +401,13 @@ bool RunGetHistory(const FString& InFile, TArray<FString>& OutErrorMessages, TPl
  */
 bool UpdateCachedStates(const TArray<FPlasticSourceControlState>& InStates);
 
+/**
+ * Update the cached workspace states of a whole subtree from the results of RunWorkspaceStatus(),
+ * marking as Controlled the other files of the subtree in cache that had a pending change, and are still on disk.
+ * @returns true if any states were updated
+ */
+bool UpdateCachedWorkspaceStates(const FString& InSubtree, const TArray<FPlasticSourceControlState>& InStates);
+
 /** 
  * Remove redundant errors (that contain a particular string) and also
  * update the commands success status if all errors were removed.
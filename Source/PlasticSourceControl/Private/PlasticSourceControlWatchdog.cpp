@@ -0,0 +1,173 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlWatchdog.h"
+#include "PlasticSourceControlShell.h"
+#include "PlasticSourceControlUtils.h"
+
+namespace PlasticWatchdogConstants
+{
+	/** Budget of a type of command without any latency history yet (the former fixed timeout) */
+	static const double DefaultBudget = 60.0;
+
+	/** Minimum budget of any command, so that a loaded machine does not get quick commands killed */
+	static const double MinBudget = 15.0;
+
+	/** Maximum budget of any command */
+	static const double MaxBudget = 30.0 * 60.0;
+
+	/** Margin applied to the average plus four deviations of the longest silence */
+	static const double SafetyFactor = 3.0;
+
+	/** Weight of a new silence in the moving averages */
+	static const double Alpha = 0.2;
+
+	/** Delay between two checks of the commands in flight, in milliseconds */
+	static const uint32 CheckPeriodMs = 250;
+}
+
+FPlasticSourceControlWatchdog::FPlasticSourceControlWatchdog()
+	: Thread(nullptr)
+	, StopEvent(nullptr)
+{
+}
+
+FPlasticSourceControlWatchdog::~FPlasticSourceControlWatchdog()
+{
+	Terminate();
+}
+
+void FPlasticSourceControlWatchdog::Launch()
+{
+	if (Thread == nullptr)
+	{
+		StopTaskCounter.Reset();
+		StopEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		Thread = FRunnableThread::Create(this, TEXT("PlasticSourceControlWatchdog"), 0, TPri_BelowNormal);
+	}
+}
+
+void FPlasticSourceControlWatchdog::Terminate()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true); // calls Stop() then waits for Run() to return
+		delete Thread;
+		Thread = nullptr;
+		FPlatformProcess::ReturnSynchEventToPool(StopEvent);
+		StopEvent = nullptr;
+	}
+}
+
+void FPlasticSourceControlWatchdog::BeginCommand(FPlasticSourceControlShell* InShell, const FString& InCommand)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	FInFlightCommand InFlightCommand;
+	InFlightCommand.Shell = InShell;
+	InFlightCommand.Command = InCommand;
+	InFlightCommand.StartTimestamp = FPlatformTime::Seconds();
+	InFlightCommand.Budget = ComputeBudget(InCommand);
+	InFlightCommand.bAbortable = PlasticSourceControlUtils::IsRetryableCommand(InCommand);
+	InFlightCommand.bAborted = false;
+	InFlightCommand.bWarned = false;
+	InFlightCommands.Add(InFlightCommand);
+}
+
+void FPlasticSourceControlWatchdog::EndCommand(FPlasticSourceControlShell* InShell)
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	const int32 Index = InFlightCommands.IndexOfByPredicate([InShell](const FInFlightCommand& InFlightCommand) { return InFlightCommand.Shell == InShell; });
+	if (Index != INDEX_NONE)
+	{
+		const FInFlightCommand& InFlightCommand = InFlightCommands[Index];
+		FLatencyHistory& History = LatencyHistories.FindOrAdd(InFlightCommand.Command);
+		if (InFlightCommand.bAborted)
+		{
+			// The budget was too tight (or cm was really wedged): widen it for the next commands of this type, starting with the retry
+			History.Average = FMath::Max(History.Average, InFlightCommand.Budget);
+		}
+		else
+		{
+			// The budget is compared to the silence of the command, not to its total duration: learn its longest silence
+			const double Silence = FMath::Max(InFlightCommand.Shell->GetLongestSilence(), FPlatformTime::Seconds() - InFlightCommand.Shell->GetLastActivity());
+			if (History.NbSamples == 0)
+			{
+				History.Average = Silence;
+				History.Deviation = Silence / 2.0;
+			}
+			else
+			{
+				History.Deviation += PlasticWatchdogConstants::Alpha * (FMath::Abs(Silence - History.Average) - History.Deviation);
+				History.Average += PlasticWatchdogConstants::Alpha * (Silence - History.Average);
+			}
+			History.NbSamples++;
+		}
+		InFlightCommands.RemoveAtSwap(Index);
+	}
+}
+
+double FPlasticSourceControlWatchdog::GetBudget(const FString& InCommand) const
+{
+	FScopeLock ScopeLock(&CriticalSection);
+	return ComputeBudget(InCommand);
+}
+
+double FPlasticSourceControlWatchdog::ComputeBudget(const FString& InCommand) const
+{
+	const FLatencyHistory* History = LatencyHistories.Find(InCommand);
+	if ((History == nullptr) || ((History->NbSamples == 0) && (History->Average == 0.0)))
+	{
+		return PlasticWatchdogConstants::DefaultBudget;
+	}
+	const double Budget = PlasticWatchdogConstants::SafetyFactor * (History->Average + 4.0 * History->Deviation);
+	return FMath::Clamp(Budget, PlasticWatchdogConstants::MinBudget, PlasticWatchdogConstants::MaxBudget);
+}
+
+uint32 FPlasticSourceControlWatchdog::Run()
+{
+	while (StopTaskCounter.GetValue() == 0)
+	{
+		CheckInFlightCommands();
+		StopEvent->Wait(PlasticWatchdogConstants::CheckPeriodMs);
+	}
+	return 0;
+}
+
+void FPlasticSourceControlWatchdog::Stop()
+{
+	StopTaskCounter.Increment();
+	if (StopEvent != nullptr)
+	{
+		StopEvent->Trigger();
+	}
+}
+
+void FPlasticSourceControlWatchdog::CheckInFlightCommands()
+{
+	FScopeLock ScopeLock(&CriticalSection);
+
+	const double Now = FPlatformTime::Seconds();
+	for (FInFlightCommand& InFlightCommand : InFlightCommands)
+	{
+		// The budget applies to the silence of the command: a lengthy operation outputting its progress is never aborted
+		const double Silence = Now - FMath::Max(InFlightCommand.StartTimestamp, InFlightCommand.Shell->GetLastActivity());
+		if (!InFlightCommand.bAborted && !InFlightCommand.bWarned && (Silence > InFlightCommand.Budget))
+		{
+			if (InFlightCommand.bAbortable)
+			{
+				UE_LOG(LogSourceControl, Warning, TEXT("Watchdog: '%s' silent for '%lf's on 'cm shell'[%d] (budget '%lf's): aborting it"), *InFlightCommand.Command, Silence, InFlightCommand.Shell->GetIndex(), InFlightCommand.Budget);
+				InFlightCommand.bAborted = true;
+				// killed under the lock, so that the shell cannot end its command and be restarted meanwhile
+				InFlightCommand.Shell->Abort();
+			}
+			else
+			{
+				// Killing cm in the middle of a checkin, an update or an undo could leave the workspace half-updated: let the user decide to cancel it
+				UE_LOG(LogSourceControl, Warning, TEXT("Watchdog: '%s' silent for '%lf's on 'cm shell'[%d] (budget '%lf's): not aborting a command changing the workspace"), *InFlightCommand.Command, Silence, InFlightCommand.Shell->GetIndex(), InFlightCommand.Budget);
+				InFlightCommand.bWarned = true;
+			}
+		}
+	}
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+class FPlasticSourceControlShell;
+
+/**
+ * Watchdog thread tracking every command in flight on the 'cm shell' processes against a timeout budget for its type of command,
+ * and killing any 'cm shell' staying silent for longer than its budget, if its command can be retried safely
+ * (a command changing the workspace or the repository, like checkin or update, is only reported, never aborted half-way).
+ *
+ * The budget of each type of command is learned from the history of its longest silences between two outputs (moving average and deviation),
+ * so that a quick "whoami" and a lengthy "update" are not judged by the same fixed timeout,
+ * and the budget matches what it is compared to (a long command steadily outputting its progress does not inflate it).
+ */
+class FPlasticSourceControlWatchdog : public FRunnable
+{
+public:
+	FPlasticSourceControlWatchdog();
+	virtual ~FPlasticSourceControlWatchdog();
+
+	/** Start the watchdog thread (if not already running) */
+	void Launch();
+
+	/** Stop the watchdog thread and wait for its termination */
+	void Terminate();
+
+	/**
+	 * Start tracking a command sent to a 'cm shell'
+	 * @param	InShell			The shell running the command, killed in case of timeout
+	 * @param	InCommand		The Plastic command - e.g. status
+	 */
+	void BeginCommand(FPlasticSourceControlShell* InShell, const FString& InCommand);
+
+	/** Stop tracking the command of the shell, learning from its longest silence (unless it has been aborted) */
+	void EndCommand(FPlasticSourceControlShell* InShell);
+
+	/** Get the current timeout budget for the given type of command, in seconds */
+	double GetBudget(const FString& InCommand) const;
+
+	// FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Silence history of one type of command, as exponentially weighted moving averages */
+	struct FLatencyHistory
+	{
+		FLatencyHistory()
+			: Average(0.0)
+			, Deviation(0.0)
+			, NbSamples(0)
+		{
+		}
+
+		/** Moving average of the longest silence between two outputs of the command, in seconds */
+		double Average;
+
+		/** Moving average of the absolute deviation from the average silence, in seconds */
+		double Deviation;
+
+		/** Number of silences learned */
+		int32 NbSamples;
+	};
+
+	/** A command currently running on a 'cm shell' */
+	struct FInFlightCommand
+	{
+		FPlasticSourceControlShell* Shell;
+		FString Command;
+		double StartTimestamp;
+		double Budget;
+		/** Can the command be retried safely, and thus be aborted */
+		bool bAbortable;
+		bool bAborted;
+		/** Has the command been reported for overrunning its budget, without being aborted */
+		bool bWarned;
+	};
+
+	/** Budget of a type of command, without locking */
+	double ComputeBudget(const FString& InCommand) const;
+
+	/** Kill the shells of the retryable commands that have been silent for longer than their budget, report the others */
+	void CheckInFlightCommands();
+
+	/** Critical section protecting the latency history and the commands in flight */
+	mutable FCriticalSection CriticalSection;
+
+	/** Silence history by type of command */
+	TMap<FString, FLatencyHistory> LatencyHistories;
+
+	/** Commands currently running, one at most by shell */
+	TArray<FInFlightCommand> InFlightCommands;
+
+	/** The watchdog thread */
+	FRunnableThread* Thread;
+
+	/** Event used to wake up the watchdog thread early to stop it */
+	FEvent* StopEvent;
+
+	/** Set to stop the watchdog thread */
+	FThreadSafeCounter StopTaskCounter;
+};
@@ -0,0 +1,189 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#include "PlasticSourceControlPrivatePCH.h"
+#include "PlasticSourceControlWorkspaceWatcher.h"
+#include "DirectoryWatcherModule.h"
+
+namespace PlasticWorkspaceWatcherConstants
+{
+	/**
+	 * Delay after the last command of the provider writing to the workspace (checkout, checkin, revert...) during which changes of the metadata
+	 * of the workspace are attributed to it, in seconds. Only these commands count: the continuous refreshes of the cache would otherwise
+	 * extend the grace period forever, hiding the operations made meanwhile by another Plastic client.
+	 */
+	static const double OwnActivityGracePeriod = 2.0;
+}
+
+FPlasticSourceControlWorkspaceWatcher::FPlasticSourceControlWorkspaceWatcher()
+	: bWatching(false)
+	, Generation(0)
+	, InvalidationGeneration(0)
+	, LastOwnActivityTimestamp(0.0)
+{
+}
+
+FPlasticSourceControlWorkspaceWatcher::~FPlasticSourceControlWorkspaceWatcher()
+{
+	Stop();
+}
+
+bool FPlasticSourceControlWorkspaceWatcher::Start(const FString& InWorkspaceRoot)
+{
+	if (!bWatching)
+	{
+		WorkspaceRoot = InWorkspaceRoot;
+		FDirectoryWatcherModule& DirectoryWatcherModule = FModuleManager::LoadModuleChecked<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
+		IDirectoryWatcher* DirectoryWatcher = DirectoryWatcherModule.Get();
+		if (DirectoryWatcher != nullptr)
+		{
+			bWatching = DirectoryWatcher->RegisterDirectoryChangedCallback_Handle(WorkspaceRoot, IDirectoryWatcher::FDirectoryChanged::CreateRaw(this, &FPlasticSourceControlWorkspaceWatcher::OnDirectoryChanged), DirectoryChangedHandle, true);
+		}
+		UE_LOG(LogSourceControl, Log, TEXT("Workspace watcher: %s '%s'"), bWatching ? TEXT("watching") : TEXT("unable to watch"), *WorkspaceRoot);
+	}
+	return bWatching;
+}
+
+void FPlasticSourceControlWorkspaceWatcher::Stop()
+{
+	if (bWatching)
+	{
+		// the DirectoryWatcher module may already have been unloaded at exit
+		FDirectoryWatcherModule* DirectoryWatcherModule = FModuleManager::GetModulePtr<FDirectoryWatcherModule>(TEXT("DirectoryWatcher"));
+		if ((DirectoryWatcherModule != nullptr) && (DirectoryWatcherModule->Get() != nullptr))
+		{
+			DirectoryWatcherModule->Get()->UnregisterDirectoryChangedCallback_Handle(WorkspaceRoot, DirectoryChangedHandle);
+		}
+		DirectoryChangedHandle.Reset();
+		bWatching = false;
+	}
+	DirtyPaths.Empty();
+	TrustedFiles.Empty();
+	ChangeGenerations.Empty();
+	RemovalGenerations.Empty();
+}
+
+void FPlasticSourceControlWorkspaceWatcher::Trust(const TArray<FString>& InFiles, const uint64 InDispatchGeneration)
+{
+	// an invalidation since the command has been dispatched makes all its results obsolete already
+	if (bWatching && (InDispatchGeneration >= InvalidationGeneration))
+	{
+		for (const FString& File : InFiles)
+		{
+			// as does a change of the file notified since then (even if it has already been consumed by a refresh)
+			if (!HasChangedSince(File, InDispatchGeneration))
+			{
+				TrustedFiles.Add(File);
+			}
+		}
+	}
+}
+
+bool FPlasticSourceControlWorkspaceWatcher::HasChangedSince(const FString& InFilename, const uint64 InGeneration) const
+{
+	const uint64* ChangeGeneration = ChangeGenerations.Find(InFilename);
+	if ((ChangeGeneration != nullptr) && (*ChangeGeneration > InGeneration))
+	{
+		return true;
+	}
+	if (RemovalGenerations.Num() > 0)
+	{
+		// removal (or rename) of one of its directories
+		for (FString Directory = FPaths::GetPath(InFilename); Directory.Len() > WorkspaceRoot.Len(); Directory = FPaths::GetPath(Directory))
+		{
+			const uint64* RemovalGeneration = RemovalGenerations.Find(Directory);
+			if ((RemovalGeneration != nullptr) && (*RemovalGeneration > InGeneration))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool FPlasticSourceControlWorkspaceWatcher::IsTrusted(const FString& InFilename) const
+{
+	return bWatching && TrustedFiles.Contains(InFilename);
+}
+
+void FPlasticSourceControlWorkspaceWatcher::Invalidate()
+{
+	if (TrustedFiles.Num() > 0)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Workspace watcher: %d states not trusted anymore"), TrustedFiles.Num());
+		TrustedFiles.Empty();
+	}
+	// nor the states of the commands still in flight
+	InvalidationGeneration = ++Generation;
+}
+
+void FPlasticSourceControlWorkspaceWatcher::ConsumeDirtyPaths(TArray<FString>& OutPaths)
+{
+	OutPaths = DirtyPaths.Array();
+	DirtyPaths.Empty();
+}
+
+void FPlasticSourceControlWorkspaceWatcher::NotifyOwnActivity()
+{
+	LastOwnActivityTimestamp = FPlatformTime::Seconds();
+}
+
+void FPlasticSourceControlWorkspaceWatcher::ForgetChangesBefore(const uint64 InOldestDispatchGeneration)
+{
+	for (auto It = ChangeGenerations.CreateIterator(); It; ++It)
+	{
+		if (It.Value() <= InOldestDispatchGeneration)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (auto It = RemovalGenerations.CreateIterator(); It; ++It)
+	{
+		if (It.Value() <= InOldestDispatchGeneration)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FPlasticSourceControlWorkspaceWatcher::OnDirectoryChanged(const TArray<FFileChangeData>& InFileChanges)
+{
+	for (const FFileChangeData& FileChange : InFileChanges)
+	{
+		FString Path = FileChange.Filename;
+		FPaths::NormalizeFilename(Path);
+
+		if (Path.Contains(TEXT("/.plastic/")))
+		{
+			// A switch to another branch or workspace changes every state, while other changes of the metadata of the workspace
+			// that are not made by the commands of the provider are made by another Plastic client (checkin, update, undo...)
+			const FString MetadataFilename = FPaths::GetCleanFilename(Path);
+			const bool bSwitched = (MetadataFilename == TEXT("plastic.selector")) || (MetadataFilename == TEXT("plastic.workspace"));
+			if (bSwitched || (FPlatformTime::Seconds() - LastOwnActivityTimestamp > PlasticWorkspaceWatcherConstants::OwnActivityGracePeriod))
+			{
+				Invalidate();
+			}
+		}
+		else if (!Path.Contains(TEXT("/Intermediate/")) && !Path.Contains(TEXT("/Saved/")) && !Path.Contains(TEXT("/DerivedDataCache/")))
+		{
+			// Skip the directories generated by the Engine (never versioned)
+			DirtyPaths.Add(Path);
+			ChangeGenerations.Add(Path, ++Generation);
+			if (FileChange.Action == FFileChangeData::FCA_Removed)
+			{
+				RemovalGenerations.Add(Path, Generation);
+			}
+			if ((TrustedFiles.Remove(Path) == 0) && (FileChange.Action == FFileChangeData::FCA_Removed))
+			{
+				// removal (or rename) of a whole directory
+				const FString Directory = Path / TEXT("");
+				for (auto It = TrustedFiles.CreateIterator(); It; ++It)
+				{
+					if (It->StartsWith(Directory))
+					{
+						It.RemoveCurrent();
+					}
+				}
+			}
+		}
+	}
+}
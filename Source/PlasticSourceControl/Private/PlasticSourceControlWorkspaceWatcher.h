@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Codice Software - Sebastien Rombauts (sebastien.rombauts@gmail.com)
+
+#pragma once
+
+#include "IDirectoryWatcher.h"
+
+/**
+ * Workspace watcher: listens to the changes of the files of the workspace reported by the file system
+ * (through the DirectoryWatcher module of the Engine: inotify on Linux, ReadDirectoryChangesW on Windows, FSEvents on Mac).
+ *
+ * - dirty set: paths created, modified, deleted or renamed since they have last been consumed by a refresh
+ * - trusted set: files whose state has been read from cm while watching, and not changed on disk since,
+ *   so that their cached state can be used instead of querying cm again
+ * - generations: each change is numbered, so that only the results of the commands dispatched after the last change of a file are trusted
+ *
+ * Everything is done on the game thread, where the DirectoryWatcher module dispatches its notifications.
+ */
+class FPlasticSourceControlWorkspaceWatcher
+{
+public:
+	FPlasticSourceControlWorkspaceWatcher();
+	~FPlasticSourceControlWorkspaceWatcher();
+
+	/**
+	 * Start watching the workspace (if not already watching)
+	 * @param	InWorkspaceRoot		The root of the workspace
+	 * @returns true if the workspace is being watched
+	 */
+	bool Start(const FString& InWorkspaceRoot);
+
+	/** Stop watching the workspace, forgetting about dirty and trusted files */
+	void Stop();
+
+	/** Is the workspace being watched */
+	inline bool IsWatching() const
+	{
+		return bWatching;
+	}
+
+	/** Current generation of the changes, to be recorded when dispatching a command whose results may then be trusted */
+	inline uint64 GetGeneration() const
+	{
+		return Generation;
+	}
+
+	/**
+	 * Trust the states of these files just read from cm, unless they have changed on disk since the command has been dispatched
+	 * @param	InFiles					The files queried by the command
+	 * @param	InDispatchGeneration	The generation of the changes when the command has been dispatched
+	 */
+	void Trust(const TArray<FString>& InFiles, const uint64 InDispatchGeneration);
+
+	/** Has the state of the file been read from cm while watching, without any change on disk since */
+	bool IsTrusted(const FString& InFilename) const;
+
+	/** Stop trusting any state (after a change of the workspace changeset, or of its metadata) */
+	void Invalidate();
+
+	/** Take the paths that have changed on disk since the last call */
+	void ConsumeDirtyPaths(TArray<FString>& OutPaths);
+
+	/** Record that the provider has some commands in flight that write to the workspace, updating its metadata by themselves */
+	void NotifyOwnActivity();
+
+	/** Forget the generation of the changes older than the oldest command in flight, that cannot matter anymore */
+	void ForgetChangesBefore(const uint64 InOldestDispatchGeneration);
+
+private:
+	/** Callback of the DirectoryWatcher module */
+	void OnDirectoryChanged(const TArray<struct FFileChangeData>& InFileChanges);
+
+	/** Has the file, or one of its directories removed, changed since the given generation */
+	bool HasChangedSince(const FString& InFilename, const uint64 InGeneration) const;
+
+	/** The root of the workspace, being watched */
+	FString WorkspaceRoot;
+
+	/** Handle of the registration to the DirectoryWatcher module */
+	FDelegateHandle DirectoryChangedHandle;
+
+	/** Is the workspace being watched */
+	bool bWatching;
+
+	/** Paths that have changed on disk since the last refresh */
+	TSet<FString> DirtyPaths;
+
+	/** Files whose state has been read from cm while watching, and not changed on disk since */
+	TSet<FString> TrustedFiles;
+
+	/** Generation of the changes, incremented for each change notified (and each invalidation) */
+	uint64 Generation;
+
+	/** Generation of the last change of each path, as long as some command dispatched before it may still be in flight */
+	TMap<FString, uint64> ChangeGenerations;
+
+	/** Generation of the last removal of each path, telling the removals of whole directories (idem) */
+	TMap<FString, uint64> RemovalGenerations;
+
+	/** Generation of the last invalidation of all the states */
+	uint64 InvalidationGeneration;
+
+	/** Last time the provider had some commands in flight writing to the workspace */
+	double LastOwnActivityTimestamp;
+};